@@ -18,7 +18,9 @@ const float pi = 3.14159265;
 void main()
 {
 
-    vec3 color = vec3(texture2D(sampler, fragment_uv));
+    vec2 tile = floor(fragment_uv / 1024.0);
+    vec2 uv = (tile + clamp(fract(fragment_uv), 1.0 / 128.0, 127.0 / 128.0)) / 16.0;
+    vec3 color = vec3(texture2D(sampler, uv));
 
     if (color == vec3(1.0, 0.0, 1.0))
     {
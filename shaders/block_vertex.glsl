@@ -4,6 +4,8 @@ uniform mat4 matrix;
 uniform vec3 camera;
 uniform float fog_distance;
 uniform int ortho;
+uniform int vertex_format;
+uniform vec3 origin;
 
 attribute vec4 position;
 attribute vec3 normal;
@@ -21,11 +23,42 @@ const float pi = 3.14159265;
 void main()
 {
 
-    gl_Position = matrix * position;
+    vec4 world = position;
+    vec4 attributes = uv;
 
-    fragment_uv = uv.xy;
-    fragment_ao = 0.3 + (1.0 - uv.z) * 0.7;
-    fragment_light = uv.w;
+    if (vertex_format == 1)
+    {
+
+        vec3 offset = vec3(mod(position.x, 512.0), position.y, position.z) / 8.0;
+        vec3 block = offset - 0.5;
+        float face = mod(floor(position.x / 512.0), 8.0);
+        float corner = floor(position.x / 4096.0);
+        float tile = mod(position.w, 256.0);
+        vec2 local = vec2(mod(corner, 2.0), floor(corner / 2.0));
+
+        if (face == 0.0)
+            local = block.zy;
+        else if (face == 1.0)
+            local = vec2(32.0 - block.z, block.y);
+        else if (face == 2.0)
+            local = vec2(block.x, 32.0 - block.z);
+        else if (face == 3.0)
+            local = block.xz;
+        else if (face == 4.0)
+            local = block.xy;
+        else if (face == 5.0)
+            local = vec2(32.0 - block.x, block.y);
+
+        world = vec4(origin + offset, 1.0);
+        attributes = vec4(vec2(mod(tile, 16.0), floor(tile / 16.0)) * 1024.0 + local, mod(floor(position.w / 256.0), 16.0) / 15.0, floor(position.w / 4096.0) / 15.0);
+
+    }
+
+    gl_Position = matrix * world;
+
+    fragment_uv = attributes.xy;
+    fragment_ao = 0.3 + (1.0 - attributes.z) * 0.7;
+    fragment_light = attributes.w;
     diffuse = 1.0;
 
     if (bool(ortho))
@@ -39,12 +72,12 @@ void main()
     else
     {
 
-        float camera_distance = distance(camera, vec3(position));
+        float camera_distance = distance(camera, vec3(world));
 
         fog_factor = pow(clamp(camera_distance / fog_distance, 0.0, 1.0), 4.0);
 
-        float dy = position.y - camera.y;
-        float dx = distance(position.xz, camera.xz);
+        float dy = world.y - camera.y;
+        float dx = distance(world.xz, camera.xz);
 
         fog_height = (atan(dy, dx) + pi / 2) / pi;
 
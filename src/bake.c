@@ -0,0 +1,237 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "palette.h"
+#include "map.h"
+#include "cold.h"
+#include "bake.h"
+
+#define BAKE_MAGIC                      0x54465243
+#define BAKE_VERSION                    1
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int seed;
+    int p;
+    int q;
+    int width;
+    int height;
+} BakeHeader;
+
+typedef struct {
+    unsigned int offset;
+    unsigned int size;
+} BakeRecord;
+
+typedef struct {
+    FILE *file;
+    BakeHeader header;
+    BakeRecord *records;
+} BakeFile;
+
+static BakeFile writer;
+static BakeFile reader;
+static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char buffer[COLD_MAX_SIZE];
+static BakeStats stats;
+
+static BakeRecord *record(BakeFile *bake, int p, int q)
+{
+
+    int x = p - bake->header.p;
+    int z = q - bake->header.q;
+
+    if (!bake->records)
+        return 0;
+
+    if (x < 0 || x >= bake->header.width) return 0;
+    if (z < 0 || z >= bake->header.height) return 0;
+
+    return bake->records + z * bake->header.width + x;
+
+}
+
+static void release(BakeFile *bake)
+{
+
+    if (bake->file)
+        fclose(bake->file);
+
+    free(bake->records);
+    memset(bake, 0, sizeof(BakeFile));
+
+}
+
+int bake_create(const char *path, unsigned int seed, int p, int q, int width, int height)
+{
+
+    unsigned int count = width * height;
+
+    writer.file = fopen(path, "wb");
+
+    if (!writer.file)
+        return 0;
+
+    writer.header.magic = BAKE_MAGIC;
+    writer.header.version = BAKE_VERSION;
+    writer.header.seed = seed;
+    writer.header.p = p;
+    writer.header.q = q;
+    writer.header.width = width;
+    writer.header.height = height;
+    writer.records = (BakeRecord *)calloc(count, sizeof(BakeRecord));
+
+    if (fwrite(&writer.header, sizeof(BakeHeader), 1, writer.file) != 1 || fwrite(writer.records, sizeof(BakeRecord), count, writer.file) != count)
+    {
+
+        release(&writer);
+
+        return 0;
+
+    }
+
+    return 1;
+
+}
+
+int bake_write(int p, int q, unsigned char *data, unsigned int size)
+{
+
+    BakeRecord *entry;
+    int result = 0;
+
+    pthread_mutex_lock(&write_mutex);
+
+    entry = record(&writer, p, q);
+
+    if (entry)
+    {
+
+        unsigned int offset = ftell(writer.file);
+
+        result = fwrite(data, 1, size, writer.file) == size;
+
+        if (result)
+        {
+
+            entry->offset = offset;
+            entry->size = size;
+
+        }
+
+    }
+
+    pthread_mutex_unlock(&write_mutex);
+
+    return result;
+
+}
+
+int bake_finish(void)
+{
+
+    unsigned int count = writer.header.width * writer.header.height;
+    int result;
+
+    if (!writer.file)
+        return 0;
+
+    result = fseek(writer.file, sizeof(BakeHeader), SEEK_SET) == 0 && fwrite(writer.records, sizeof(BakeRecord), count, writer.file) == count;
+
+    if (fclose(writer.file))
+        result = 0;
+
+    writer.file = 0;
+
+    release(&writer);
+
+    return result;
+
+}
+
+int bake_open(const char *path, unsigned int seed)
+{
+
+    unsigned int count;
+
+    release(&reader);
+
+    reader.file = fopen(path, "rb");
+
+    if (!reader.file)
+        return 0;
+
+    if (fread(&reader.header, sizeof(BakeHeader), 1, reader.file) != 1 || reader.header.magic != BAKE_MAGIC || reader.header.version != BAKE_VERSION || reader.header.seed != seed || reader.header.width <= 0 || reader.header.height <= 0)
+    {
+
+        release(&reader);
+
+        return 0;
+
+    }
+
+    count = reader.header.width * reader.header.height;
+    reader.records = (BakeRecord *)malloc(count * sizeof(BakeRecord));
+
+    if (fread(reader.records, sizeof(BakeRecord), count, reader.file) != count)
+    {
+
+        release(&reader);
+
+        return 0;
+
+    }
+
+    return 1;
+
+}
+
+int bake_load(Map *map, short *heights, int p, int q)
+{
+
+    BakeRecord *entry = record(&reader, p, q);
+
+    if (!entry || !entry->size || entry->size > COLD_MAX_SIZE)
+    {
+
+        stats.misses++;
+
+        return 0;
+
+    }
+
+    if (fseek(reader.file, entry->offset, SEEK_SET) || fread(buffer, 1, entry->size, reader.file) != entry->size)
+    {
+
+        stats.misses++;
+
+        return 0;
+
+    }
+
+    cold_decode(map, heights, p, q, buffer);
+
+    stats.loads++;
+    stats.bytes += entry->size;
+
+    return 1;
+
+}
+
+void bake_close(void)
+{
+
+    release(&reader);
+
+}
+
+void bake_stats(BakeStats *out)
+{
+
+    memcpy(out, &stats, sizeof(BakeStats));
+    memset(&stats, 0, sizeof(BakeStats));
+
+}
@@ -0,0 +1,13 @@
+typedef struct {
+    unsigned int loads;
+    unsigned int misses;
+    unsigned int bytes;
+} BakeStats;
+
+int bake_create(const char *path, unsigned int seed, int p, int q, int width, int height);
+int bake_write(int p, int q, unsigned char *data, unsigned int size);
+int bake_finish(void);
+int bake_open(const char *path, unsigned int seed);
+int bake_load(Map *map, short *heights, int p, int q);
+void bake_close(void);
+void bake_stats(BakeStats *stats);
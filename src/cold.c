@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "palette.h"
+#include "map.h"
+#include "cold.h"
+
+#define COLD_MAX_ENTRIES                4096
+#define COLD_INDEX_SIZE                 (COLD_MAX_ENTRIES * 2)
+
+typedef struct {
+    int p;
+    int q;
+    int prev;
+    int next;
+    unsigned int version;
+    unsigned int size;
+    unsigned char *data;
+} ColdEntry;
+
+static ColdEntry entries[COLD_MAX_ENTRIES];
+static int slots[COLD_INDEX_SIZE];
+static unsigned char buffer[COLD_MAX_SIZE];
+static unsigned int count;
+static unsigned int bytes;
+static int oldest = -1;
+static int newest = -1;
+static ColdStats stats;
+
+static unsigned int hash(int p, int q)
+{
+
+    return ((unsigned int)p * 73856093 ^ (unsigned int)q * 19349663) & (COLD_INDEX_SIZE - 1);
+
+}
+
+static unsigned int locate(int p, int q)
+{
+
+    unsigned int index = hash(p, q);
+
+    while (slots[index])
+    {
+
+        ColdEntry *entry = entries + slots[index] - 1;
+
+        if (entry->p == p && entry->q == q)
+            break;
+
+        index = (index + 1) & (COLD_INDEX_SIZE - 1);
+
+    }
+
+    return index;
+
+}
+
+static ColdEntry *find(int p, int q)
+{
+
+    unsigned int index = locate(p, q);
+
+    return slots[index] ? entries + slots[index] - 1 : 0;
+
+}
+
+static void unindex(int p, int q)
+{
+
+    unsigned int index = locate(p, q);
+    unsigned int next;
+
+    if (!slots[index])
+        return;
+
+    slots[index] = 0;
+    next = (index + 1) & (COLD_INDEX_SIZE - 1);
+
+    while (slots[next])
+    {
+
+        ColdEntry *entry = entries + slots[next] - 1;
+        unsigned int home = hash(entry->p, entry->q);
+
+        if (((next - home) & (COLD_INDEX_SIZE - 1)) >= ((next - index) & (COLD_INDEX_SIZE - 1)))
+        {
+
+            slots[index] = slots[next];
+            slots[next] = 0;
+            index = next;
+
+        }
+
+        next = (next + 1) & (COLD_INDEX_SIZE - 1);
+
+    }
+
+}
+
+static void relink(int i)
+{
+
+    ColdEntry *entry = entries + i;
+
+    if (entry->prev >= 0)
+        entries[entry->prev].next = i;
+    else
+        oldest = i;
+
+    if (entry->next >= 0)
+        entries[entry->next].prev = i;
+    else
+        newest = i;
+
+}
+
+static void discard(ColdEntry *entry)
+{
+
+    int i = entry - entries;
+    int last;
+
+    unindex(entry->p, entry->q);
+
+    if (entry->prev >= 0)
+        entries[entry->prev].next = entry->next;
+    else
+        oldest = entry->next;
+
+    if (entry->next >= 0)
+        entries[entry->next].prev = entry->prev;
+    else
+        newest = entry->prev;
+
+    bytes -= entry->size;
+
+    free(entry->data);
+
+    last = --count;
+
+    if (i == last)
+        return;
+
+    memcpy(entry, entries + last, sizeof(ColdEntry));
+
+    slots[locate(entry->p, entry->q)] = i + 1;
+
+    relink(i);
+
+}
+
+static void evict(unsigned int size)
+{
+
+    while (count && (count == COLD_MAX_ENTRIES || bytes + size > COLD_CACHE_SIZE))
+    {
+
+        discard(entries + oldest);
+
+        stats.evictions++;
+
+    }
+
+}
+
+unsigned int cold_encode(Map *map, int p, int q, unsigned char *out)
+{
+
+    unsigned int size = 0;
+    int column[Y_SIZE];
+    int dx, dz, y;
+
+    for (dz = 0; dz < CHUNK_SIZE; dz++)
+    {
+
+        for (dx = 0; dx < CHUNK_SIZE; dx++)
+        {
+
+            map_get_column(map, p * CHUNK_SIZE + dx, 0, q * CHUNK_SIZE + dz, Y_SIZE, column);
+
+            for (y = 0; y < Y_SIZE;)
+            {
+
+                int w = column[y];
+                int start = y;
+
+                while (y < Y_SIZE && column[y] == w)
+                    y++;
+
+                out[size++] = y - start - 1;
+                out[size++] = w;
+
+            }
+
+        }
+
+    }
+
+    return size;
+
+}
+
+void cold_decode(Map *map, short *heights, int p, int q, unsigned char *data)
+{
+
+    MapBuilder builder;
+    int dx, dz;
+
+    map_builder_alloc(&builder, map->dx, map->dy, map->dz);
+
+    for (dz = 0; dz < CHUNK_SIZE; dz++)
+    {
+
+        for (dx = 0; dx < CHUNK_SIZE; dx++)
+        {
+
+            int x = p * CHUNK_SIZE + dx;
+            int z = q * CHUNK_SIZE + dz;
+            int top = -1;
+            int y = 0;
+
+            while (y < Y_SIZE)
+            {
+
+                int length = *data++ + 1;
+                int w = *data++;
+
+                if (w)
+                {
+
+                    map_builder_fill(&builder, x, y, y + length, z, w);
+
+                    top = y + length - 1;
+
+                }
+
+                y += length;
+
+            }
+
+            heights[dz * CHUNK_SIZE + dx] = top;
+
+        }
+
+    }
+
+    map_build(map, &builder);
+    map_builder_free(&builder);
+
+}
+
+void cold_store(Map *map, int p, int q, unsigned int version)
+{
+
+    ColdEntry *entry;
+    unsigned int size;
+
+    if (!COLD_CACHE_SIZE)
+        return;
+
+    entry = find(p, q);
+
+    if (entry)
+        discard(entry);
+
+    size = cold_encode(map, p, q, buffer);
+
+    if (size > COLD_CACHE_SIZE)
+        return;
+
+    evict(size);
+
+    entry = entries + count;
+    entry->p = p;
+    entry->q = q;
+    entry->prev = newest;
+    entry->next = -1;
+    entry->version = version;
+    entry->size = size;
+    entry->data = (unsigned char *)malloc(size);
+
+    memcpy(entry->data, buffer, size);
+
+    slots[locate(p, q)] = count + 1;
+
+    relink(count++);
+
+    bytes += size;
+    stats.stores++;
+
+}
+
+int cold_load(Map *map, short *heights, int p, int q, unsigned int *version)
+{
+
+    ColdEntry *entry = find(p, q);
+
+    if (!entry)
+    {
+
+        stats.misses++;
+
+        return 0;
+
+    }
+
+    cold_decode(map, heights, p, q, entry->data);
+    *version = entry->version;
+    discard(entry);
+
+    stats.hits++;
+
+    return 1;
+
+}
+
+void cold_clear(void)
+{
+
+    while (count)
+        discard(entries + count - 1);
+
+}
+
+void cold_stats(ColdStats *out)
+{
+
+    stats.count = count;
+    stats.bytes = bytes;
+
+    memcpy(out, &stats, sizeof(ColdStats));
+    memset(&stats, 0, sizeof(ColdStats));
+
+}
@@ -0,0 +1,17 @@
+#define COLD_MAX_SIZE                   (CHUNK_SIZE * CHUNK_SIZE * Y_SIZE * 2)
+
+typedef struct {
+    unsigned int stores;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    unsigned int count;
+    unsigned int bytes;
+} ColdStats;
+
+unsigned int cold_encode(Map *map, int p, int q, unsigned char *out);
+void cold_decode(Map *map, short *heights, int p, int q, unsigned char *data);
+void cold_store(Map *map, int p, int q, unsigned int version);
+int cold_load(Map *map, short *heights, int p, int q, unsigned int *version);
+void cold_clear(void);
+void cold_stats(ColdStats *stats);
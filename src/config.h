@@ -17,14 +17,30 @@
 #define CRAFT_KEY_FLY                   GLFW_KEY_TAB
 #define RENDER_CHUNK_RADIUS             8
 #define MAX_CHUNKS                      1025
+#define CHUNK_INDEX_SIZE                4096
+#define MAX_WORKERS                     64
+#define MAX_JOBS                        2048
+#define CHUNK_PALETTE                   1
+#define GREEDY_MESHING                  1
+#define MAP_REHASH_BUCKETS              64
+#define POOL_RETAIN                     (64 * 1024 * 1024)
+#define POOL_HUGEPAGES                  0
+#define COLD_CACHE_SIZE                 (16 * 1024 * 1024)
+#define BAKE_FILE                       "craft.bake"
 #define MAX_TEXT_LENGTH                 256
 #define ALIGN_LEFT                      0
 #define ALIGN_CENTER                    1
 #define ALIGN_RIGHT                     2
 #define CHUNK_SIZE                      32
-#define XZ_SIZE                         (CHUNK_SIZE * 2)
 #define Y_SIZE                          256
-#define XYZ(x, y, z)                    ((y) * XZ_SIZE * XZ_SIZE + (x) * XZ_SIZE + (z))
+#define SECTION_SIZE                    16
+#define SECTION_COUNT                   (Y_SIZE / SECTION_SIZE)
+#define SECTION_ALL                     ((1 << SECTION_COUNT) - 1)
+#define CLOUD_STEP                      4
+#define MESH_SIZE                       (CHUNK_SIZE + 2)
+#define MESH_HEIGHT                     (SECTION_SIZE + 2)
+#define MESH_MASKS                      7
+#define MESH_INDEX(x, y, z)             (((y) * MESH_SIZE + (z)) * MESH_SIZE + (x))
 #define PI                              3.14159265359
 #define DEGREES(radians)                ((radians) * 180 / PI)
 #define RADIANS(degrees)                ((degrees) * PI / 180)
@@ -4,58 +4,97 @@
 #include "item.h"
 #include "matrix.h"
 
-void make_cube(float *data, float ao[6][4], float light[6][4], int faces[6], const int *tiles, float x, float y, float z, float n)
+static const float cube_positions[6][4][3] = {
+    {{-1, -1, -1}, {-1, -1, +1}, {-1, +1, -1}, {-1, +1, +1}},
+    {{+1, -1, -1}, {+1, -1, +1}, {+1, +1, -1}, {+1, +1, +1}},
+    {{-1, +1, -1}, {-1, +1, +1}, {+1, +1, -1}, {+1, +1, +1}},
+    {{-1, -1, -1}, {-1, -1, +1}, {+1, -1, -1}, {+1, -1, +1}},
+    {{-1, -1, -1}, {-1, +1, -1}, {+1, -1, -1}, {+1, +1, -1}},
+    {{-1, -1, +1}, {-1, +1, +1}, {+1, -1, +1}, {+1, +1, +1}}
+};
+
+static const float cube_normals[6][3] = {
+    {-1, 0, 0},
+    {+1, 0, 0},
+    {0, +1, 0},
+    {0, -1, 0},
+    {0, 0, -1},
+    {0, 0, +1}
+};
+
+static const float cube_uvs[6][4][2] = {
+    {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
+    {{1, 0}, {0, 0}, {1, 1}, {0, 1}},
+    {{0, 1}, {0, 0}, {1, 1}, {1, 0}},
+    {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
+    {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
+    {{1, 0}, {1, 1}, {0, 0}, {0, 1}}
+};
+
+static const int cube_axes[6][2] = {
+    {2, 1},
+    {2, 1},
+    {0, 2},
+    {0, 2},
+    {0, 1},
+    {0, 1}
+};
+
+static const float cube_indices[6][6] = {
+    {0, 3, 2, 0, 1, 3},
+    {0, 3, 1, 0, 2, 3},
+    {0, 3, 2, 0, 1, 3},
+    {0, 3, 1, 0, 2, 3},
+    {0, 3, 2, 0, 1, 3},
+    {0, 3, 1, 0, 2, 3}
+};
+
+static const float cube_flipped[6][6] = {
+    {0, 1, 2, 1, 3, 2},
+    {0, 2, 1, 2, 3, 1},
+    {0, 1, 2, 1, 3, 2},
+    {0, 2, 1, 2, 3, 1},
+    {0, 1, 2, 1, 3, 2},
+    {0, 2, 1, 2, 3, 1}
+};
+
+void make_quad(float *data, float ao[4], float light[4], int face, int tile, float x, float y, float z, float n, int lu, int lv)
 {
 
     float *d = data;
-    float s = 0.0625;
-    float a = 0 + 1 / 2048.0;
-    float b = s - 1 / 2048.0;
-
-    static const float positions[6][4][3] = {
-        {{-1, -1, -1}, {-1, -1, +1}, {-1, +1, -1}, {-1, +1, +1}},
-        {{+1, -1, -1}, {+1, -1, +1}, {+1, +1, -1}, {+1, +1, +1}},
-        {{-1, +1, -1}, {-1, +1, +1}, {+1, +1, -1}, {+1, +1, +1}},
-        {{-1, -1, -1}, {-1, -1, +1}, {+1, -1, -1}, {+1, -1, +1}},
-        {{-1, -1, -1}, {-1, +1, -1}, {+1, -1, -1}, {+1, +1, -1}},
-        {{-1, -1, +1}, {-1, +1, +1}, {+1, -1, +1}, {+1, +1, +1}}
-    };
+    float center[3] = {x, y, z};
+    float extent[3] = {1, 1, 1};
+    float du = (tile % 16) * CUBE_TILE_STRIDE;
+    float dv = (tile / 16) * CUBE_TILE_STRIDE;
+    int flip = ao[0] + ao[3] > ao[1] + ao[2];
 
-    static const float normals[6][3] = {
-        {-1, 0, 0},
-        {+1, 0, 0},
-        {0, +1, 0},
-        {0, -1, 0},
-        {0, 0, -1},
-        {0, 0, +1}
-    };
+    extent[cube_axes[face][0]] = lu;
+    extent[cube_axes[face][1]] = lv;
 
-    static const float uvs[6][4][2] = {
-        {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
-        {{1, 0}, {0, 0}, {1, 1}, {0, 1}},
-        {{0, 1}, {0, 0}, {1, 1}, {1, 0}},
-        {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
-        {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
-        {{1, 0}, {1, 1}, {0, 0}, {0, 1}}
-    };
+    for (int v = 0; v < 6; v++)
+    {
 
-    static const float indices[6][6] = {
-        {0, 3, 2, 0, 1, 3},
-        {0, 3, 1, 0, 2, 3},
-        {0, 3, 2, 0, 1, 3},
-        {0, 3, 1, 0, 2, 3},
-        {0, 3, 2, 0, 1, 3},
-        {0, 3, 1, 0, 2, 3}
-    };
+        int j = flip ? cube_flipped[face][v] : cube_indices[face][v];
 
-    static const float flipped[6][6] = {
-        {0, 1, 2, 1, 3, 2},
-        {0, 2, 1, 2, 3, 1},
-        {0, 1, 2, 1, 3, 2},
-        {0, 2, 1, 2, 3, 1},
-        {0, 1, 2, 1, 3, 2},
-        {0, 2, 1, 2, 3, 1}
-    };
+        for (int k = 0; k < 3; k++)
+            *(d++) = center[k] + (cube_positions[face][j][k] < 0 ? -n : n + 2 * n * (extent[k] - 1));
+
+        *(d++) = cube_normals[face][0];
+        *(d++) = cube_normals[face][1];
+        *(d++) = cube_normals[face][2];
+        *(d++) = du + cube_uvs[face][j][0] * lu;
+        *(d++) = dv + cube_uvs[face][j][1] * lv;
+        *(d++) = ao[j];
+        *(d++) = light[j];
+
+    }
+
+}
+
+void make_cube(float *data, float ao[6][4], float light[6][4], int faces[6], const int *tiles, float x, float y, float z, float n)
+{
+
+    float *d = data;
 
     for (int i = 0; i < 6; i++)
     {
@@ -63,28 +102,53 @@ void make_cube(float *data, float ao[6][4], float light[6][4], int faces[6], con
         if (faces[i] == 0)
             continue;
 
-        float du = (tiles[i] % 16) * s;
-        float dv = (tiles[i] / 16) * s;
-        int flip = ao[i][0] + ao[i][3] > ao[i][1] + ao[i][2];
+        make_quad(d, ao[i], light[i], i, tiles[i], x, y, z, n, 1, 1);
 
-        for (int v = 0; v < 6; v++)
+        d += 60;
+
+    }
+
+}
+
+void pack_vertices(unsigned short *out, const float *data, int count, float ox, float oy, float oz, int plant)
+{
+
+    const float *d = data;
+    unsigned short *o = out;
+
+    for (int i = 0; i < count; i++, d += 10, o += 4)
+    {
+
+        int u = floorf(d[6] / CUBE_TILE_STRIDE);
+        int v = floorf(d[7] / CUBE_TILE_STRIDE);
+        int face = 6;
+        int corner = 0;
+
+        if (plant)
         {
 
-            int j = flip ? flipped[i][v] : indices[i][v];
+            corner = (d[6] - u * CUBE_TILE_STRIDE > 0.5) | (d[7] - v * CUBE_TILE_STRIDE > 0.5) << 1;
 
-            *(d++) = x + n * positions[i][j][0];
-            *(d++) = y + n * positions[i][j][1];
-            *(d++) = z + n * positions[i][j][2];
-            *(d++) = normals[i][0];
-            *(d++) = normals[i][1];
-            *(d++) = normals[i][2];
-            *(d++) = du + (uvs[i][j][0] ? b : a);
-            *(d++) = dv + (uvs[i][j][1] ? b : a);
-            *(d++) = ao[i][j];
-            *(d++) = light[i][j];
+        }
+
+        else
+        {
+
+            for (face = 0; face < 5; face++)
+            {
+
+                if (cube_normals[face][0] == d[3] && cube_normals[face][1] == d[4] && cube_normals[face][2] == d[5])
+                    break;
+
+            }
 
         }
 
+        o[0] = (int)roundf((d[0] - ox) * 8) | face << 9 | corner << 12;
+        o[1] = (int)roundf((d[1] - oy) * 8);
+        o[2] = (int)roundf((d[2] - oz) * 8);
+        o[3] = (v * 16 + u) | (int)roundf(d[8] * 15) << 8 | (int)roundf(d[9] * 15) << 12;
+
     }
 
 }
@@ -93,11 +157,8 @@ void make_plant(float *data, float ao, float light, float px, float py, float pz
 {
 
     float *d = data;
-    float s = 0.0625;
-    float a = 0;
-    float b = s;
-    float du = (plants[w] % 16) * s;
-    float dv = (plants[w] / 16) * s;
+    float du = (plants[w] % 16) * CUBE_TILE_STRIDE;
+    float dv = (plants[w] / 16) * CUBE_TILE_STRIDE;
     float ma[16];
     float mb[16];
 
@@ -143,8 +204,8 @@ void make_plant(float *data, float ao, float light, float px, float py, float pz
             *(d++) = normals[i][0];
             *(d++) = normals[i][1];
             *(d++) = normals[i][2];
-            *(d++) = du + (uvs[i][j][0] ? b : a);
-            *(d++) = dv + (uvs[i][j][1] ? b : a);
+            *(d++) = du + uvs[i][j][0];
+            *(d++) = dv + uvs[i][j][1];
             *(d++) = ao;
             *(d++) = light;
 
@@ -1,4 +1,8 @@
+#define CUBE_TILE_STRIDE                1024
+
+void make_quad(float *data, float ao[4], float light[4], int face, int tile, float x, float y, float z, float n, int lu, int lv);
 void make_cube(float *data, float ao[6][4], float light[6][4], int faces[6], const int *tiles, float x, float y, float z, float n);
+void pack_vertices(unsigned short *out, const float *data, int count, float ox, float oy, float oz, int plant);
 void make_plant(float *data, float ao, float light, float px, float py, float pz, float n, int w, float rotation);
 void make_character(float *data, float x, float y, float n, float m, char c);
 void make_character_3d(float *data, float x, float y, float z, float n, int face, char c);
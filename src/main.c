@@ -1,17 +1,23 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include "config.h"
-#include "mtwist.h"
 #include "cube.h"
 #include "item.h"
+#include "pool.h"
+#include "palette.h"
 #include "map.h"
+#include "cold.h"
+#include "bake.h"
 #include "matrix.h"
 #include "noise.h"
+#include "world.h"
 #include "lodepng.h"
 
 typedef struct
@@ -29,6 +35,19 @@ typedef struct
 
 } Box;
 
+typedef struct
+{
+
+    int p;
+    int q;
+    int cancelled;
+    unsigned int version;
+    NoiseContext *noise;
+    Map map;
+    short heights[CHUNK_SIZE * CHUNK_SIZE];
+
+} Job;
+
 typedef struct
 {
 
@@ -37,7 +56,12 @@ typedef struct
     int q;
     int faces;
     int dirty;
-    GLuint buffer;
+    int ready;
+    unsigned int version;
+    Job *job;
+    int counts[SECTION_COUNT];
+    GLuint buffers[SECTION_COUNT];
+    short heights[CHUNK_SIZE * CHUNK_SIZE];
 
 } Chunk;
 
@@ -75,6 +99,8 @@ typedef struct
     GLuint extra2;
     GLuint extra3;
     GLuint extra4;
+    GLuint extra5;
+    GLuint extra6;
 
 } Attrib;
 
@@ -84,6 +110,21 @@ typedef struct
     GLFWwindow *window;
     Chunk chunks[MAX_CHUNKS];
     int chunk_count;
+    int chunk_index[CHUNK_INDEX_SIZE];
+    NoiseContext noise;
+    pthread_t workers[MAX_WORKERS];
+    int worker_count;
+    int worker_stop;
+    pthread_mutex_t job_mutex;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+    Job *pending[MAX_JOBS];
+    unsigned int pending_head;
+    unsigned int pending_tail;
+    Job *done[MAX_JOBS];
+    unsigned int done_head;
+    unsigned int done_tail;
+    int job_count;
     int render_radius;
     int delete_radius;
     Player player;
@@ -97,6 +138,8 @@ typedef struct
     int item_index;
     int scale;
     int ortho;
+    int show_stats;
+    int greedy;
     float fov;
     int day_length;
     unsigned int fps;
@@ -160,7 +203,7 @@ static float get_daylight()
 
 }
 
-static GLuint gen_buffer(GLsizei size, GLfloat *data)
+static GLuint gen_buffer(GLsizei size, void *data)
 {
 
     GLuint buffer;
@@ -286,6 +329,18 @@ static void draw_triangles_3d_ao(Attrib *attrib, GLuint buffer, int count)
 
 }
 
+static void draw_triangles_packed(Attrib *attrib, GLuint buffer, int count)
+{
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(attrib->position);
+    glVertexAttribPointer(attrib->position, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(GLushort) * 4, 0);
+    glDrawArrays(GL_TRIANGLES, 0, count);
+    glDisableVertexAttribArray(attrib->position);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+}
+
 static void draw_triangles_3d(Attrib *attrib, GLuint buffer, int count)
 {
 
@@ -341,17 +396,201 @@ static void draw_text(Attrib *attrib, GLuint buffer, int length)
 
 }
 
+static unsigned int chunk_hash(int p, int q)
+{
+
+    return ((unsigned int)p * 73856093 ^ (unsigned int)q * 19349663) & (CHUNK_INDEX_SIZE - 1);
+
+}
+
 static Chunk *find_chunk(int p, int q)
 {
 
-    for (int i = 0; i < g->chunk_count; i++)
+    unsigned int index = chunk_hash(p, q);
+
+    while (g->chunk_index[index])
     {
 
-        Chunk *chunk = g->chunks + i;
+        Chunk *chunk = g->chunks + g->chunk_index[index] - 1;
 
         if (chunk->p == p && chunk->q == q)
             return chunk;
 
+        index = (index + 1) & (CHUNK_INDEX_SIZE - 1);
+
+    }
+
+    return 0;
+
+}
+
+static void insert_chunk_index(int p, int q, int slot)
+{
+
+    unsigned int index = chunk_hash(p, q);
+
+    while (g->chunk_index[index])
+    {
+
+        Chunk *chunk = g->chunks + g->chunk_index[index] - 1;
+
+        if (chunk->p == p && chunk->q == q)
+            break;
+
+        index = (index + 1) & (CHUNK_INDEX_SIZE - 1);
+
+    }
+
+    g->chunk_index[index] = slot + 1;
+
+}
+
+static void remove_chunk_index(int p, int q)
+{
+
+    unsigned int index = chunk_hash(p, q);
+    unsigned int next;
+
+    while (g->chunk_index[index])
+    {
+
+        Chunk *chunk = g->chunks + g->chunk_index[index] - 1;
+
+        if (chunk->p == p && chunk->q == q)
+            break;
+
+        index = (index + 1) & (CHUNK_INDEX_SIZE - 1);
+
+    }
+
+    if (!g->chunk_index[index])
+        return;
+
+    g->chunk_index[index] = 0;
+    next = (index + 1) & (CHUNK_INDEX_SIZE - 1);
+
+    while (g->chunk_index[next])
+    {
+
+        Chunk *chunk = g->chunks + g->chunk_index[next] - 1;
+        unsigned int home = chunk_hash(chunk->p, chunk->q);
+
+        if (((next - home) & (CHUNK_INDEX_SIZE - 1)) >= ((next - index) & (CHUNK_INDEX_SIZE - 1)))
+        {
+
+            g->chunk_index[index] = g->chunk_index[next];
+            g->chunk_index[next] = 0;
+            index = next;
+
+        }
+
+        next = (next + 1) & (CHUNK_INDEX_SIZE - 1);
+
+    }
+
+}
+
+static int getbox(int x, int y, int z, int lx, int ly, int lz, int *out)
+{
+
+    int count = 0;
+    int sx, sz, ex, ez;
+
+    for (sz = z; sz < z + lz; sz = ez)
+    {
+
+        int q = chunked(sz);
+
+        ez = MIN(z + lz, (q + 1) * CHUNK_SIZE);
+
+        for (sx = x; sx < x + lx; sx = ex)
+        {
+
+            int p = chunked(sx);
+            Chunk *chunk = find_chunk(p, q);
+            int *sub = out + (sz - z) * lx + (sx - x);
+
+            ex = MIN(x + lx, (p + 1) * CHUNK_SIZE);
+
+            if (chunk && chunk->ready)
+            {
+
+                count += map_get_box(&chunk->map, sx, y, sz, ex - sx, ly, ez - sz, sub, lx, lx * lz);
+
+            }
+
+            else
+            {
+
+                int w = chunk ? STONE : EMPTY;
+                int dx, dy, dz;
+
+                for (dy = 0; dy < ly; dy++)
+                {
+
+                    for (dz = 0; dz < ez - sz; dz++)
+                    {
+
+                        for (dx = 0; dx < ex - sx; dx++)
+                            sub[dy * lx * lz + dz * lx + dx] = w;
+
+                    }
+
+                }
+
+                if (w)
+                    count += ly * (ez - sz) * (ex - sx);
+
+            }
+
+        }
+
+    }
+
+    return count;
+
+}
+
+static int getneighbors(int x, int y, int z, int *out)
+{
+
+    return getbox(x - 1, y - 1, z - 1, 3, 3, 3, out);
+
+}
+
+static void dirty_chunk(int p, int q, int sections)
+{
+
+    Chunk *chunk = find_chunk(p, q);
+
+    if (chunk)
+        chunk->dirty |= sections;
+
+}
+
+static void dirty_neighbors(int p, int q)
+{
+
+    dirty_chunk(p - 1, q, SECTION_ALL);
+    dirty_chunk(p + 1, q, SECTION_ALL);
+    dirty_chunk(p, q - 1, SECTION_ALL);
+    dirty_chunk(p, q + 1, SECTION_ALL);
+
+}
+
+static int neighbors_pending(Chunk *chunk)
+{
+
+    static const int sides[4][2] = {{-1, 0}, {+1, 0}, {0, -1}, {0, +1}};
+
+    for (int i = 0; i < 4; i++)
+    {
+
+        Chunk *other = find_chunk(chunk->p + sides[i][0], chunk->q + sides[i][1]);
+
+        if (other && !other->ready)
+            return 1;
+
     }
 
     return 0;
@@ -417,6 +656,35 @@ static int _hit_test(Map *map, float max_distance, int previous, float x, float
             py = ny;
             pz = nz;
 
+            if (ny >= 0 && ny < Y_SIZE && map_uniform(map, ny / SECTION_SIZE) == 0)
+            {
+
+                int sy = ny / SECTION_SIZE;
+                float steps;
+                int skip;
+
+                if (vy == 0)
+                    return 0;
+
+                if (vy > 0)
+                    steps = ((sy + 1) * SECTION_SIZE - 0.5 - y) * m / vy - 2;
+                else
+                    steps = (y - sy * SECTION_SIZE + 0.5) * m / -vy - 2;
+
+                skip = MIN(steps, max_distance * m - i);
+
+                if (skip > 0)
+                {
+
+                    i += skip;
+                    x += vx * skip / m;
+                    y += vy * skip / m;
+                    z += vz * skip / m;
+
+                }
+
+            }
+
         }
 
         x += vx / m;
@@ -446,31 +714,36 @@ static int hit_test(int previous, Player *player, int *bx, int *by, int *bz)
     vy = sinf(player->ry);
     vz = sinf(player->rx - RADIANS(90)) * m;
 
-    for (int i = 0; i < g->chunk_count; i++)
+    for (int dp = -1; dp <= 1; dp++)
     {
 
-        int hx, hy, hz, hw;
-
-        Chunk *chunk = g->chunks + i;
+        for (int dq = -1; dq <= 1; dq++)
+        {
 
-        if (chunk_distance(chunk, p, q) > 1)
-            continue;
+            int hx, hy, hz, hw;
 
-        hw = _hit_test(&chunk->map, 16, previous, player->box.x, player->box.y, player->box.z, vx, vy, vz, &hx, &hy, &hz);
+            Chunk *chunk = find_chunk(p + dp, q + dq);
 
-        if (hw > 0)
-        {
+            if (!chunk || !chunk->ready)
+                continue;
 
-            float d = sqrtf(powf(hx - player->box.x, 2) + powf(hy - player->box.y, 2) + powf(hz - player->box.z, 2));
+            hw = _hit_test(&chunk->map, 16, previous, player->box.x, player->box.y, player->box.z, vx, vy, vz, &hx, &hy, &hz);
 
-            if (best == 0 || d < best)
+            if (hw > 0)
             {
 
-                best = d;
-                *bx = hx;
-                *by = hy;
-                *bz = hz;
-                result = hw;
+                float d = sqrtf(powf(hx - player->box.x, 2) + powf(hy - player->box.y, 2) + powf(hz - player->box.z, 2));
+
+                if (best == 0 || d < best)
+                {
+
+                    best = d;
+                    *bx = hx;
+                    *by = hy;
+                    *bz = hz;
+                    result = hw;
+
+                }
 
             }
 
@@ -676,293 +949,668 @@ static void player_collide(Player *player, int x, int y, int z)
     block.vy = 0.0;
     block.vz = 0.0;
 
-    float newx = player->box.vx;
-    float newy = player->box.vy;
-    float newz = player->box.vz;
+    float newx = player->box.vx;
+    float newy = player->box.vy;
+    float newz = player->box.vz;
+    int neighbors[27];
+
+    getneighbors(x, y, z, neighbors);
+
+    for (int kx = -1; kx <= 1; kx++)
+    {
+
+        for (int ky = -1; ky <= 1; ky++)
+        {
+
+            for (int kz = -1; kz <= 1; kz++)
+            {
+
+                if (!is_obstacle(neighbors[(ky + 1) * 9 + (kz + 1) * 3 + (kx + 1)]))
+                    continue;
+
+                block.x = x + kx;
+                block.y = y + ky;
+                block.z = z + kz;
+
+                if (!aabbcheck(&box, &block))
+                    continue;
+
+                aabbsweep(&box, &block, &newx, &newy, &newz);
+
+            }
+
+        }
+
+    }
+
+    player->box.x += newx;
+    player->box.y += newy;
+    player->box.z += newz;
+
+}
+
+static int player_intersects_block(int height, Player *player, int hx, int hy, int hz)
+{
+
+    int nx = roundf(player->box.x);
+    int ny = roundf(player->box.y);
+    int nz = roundf(player->box.z);
+
+    for (int i = 0; i < height; i++)
+    {
+
+        if (nx == hx && ny - i == hy && nz == hz)
+            return 1;
+
+    }
+
+    return 0;
+
+}
+
+static void fill_volume(unsigned char *volume, Map *map, int p, int q, int y0)
+{
+
+    int *box = (int *)pool_alloc(sizeof(int) * CHUNK_SIZE * MESH_HEIGHT * CHUNK_SIZE);
+
+    if (map_get_box(map, p * CHUNK_SIZE, y0 - 1, q * CHUNK_SIZE, CHUNK_SIZE, MESH_HEIGHT, CHUNK_SIZE, box, CHUNK_SIZE, CHUNK_SIZE * CHUNK_SIZE))
+    {
+
+        for (int y = 0; y < MESH_HEIGHT; y++)
+        {
+
+            for (int z = 0; z < CHUNK_SIZE; z++)
+            {
+
+                unsigned char *row = volume + MESH_INDEX(1, y, z + 1);
+                int *in = box + (y * CHUNK_SIZE + z) * CHUNK_SIZE;
+
+                for (int x = 0; x < CHUNK_SIZE; x++)
+                    row[x] = in[x];
+
+            }
+
+        }
+
+    }
+
+    pool_free(box, sizeof(int) * CHUNK_SIZE * MESH_HEIGHT * CHUNK_SIZE);
+
+}
+
+static void fill_apron(unsigned char *volume, Chunk *chunk, int y0)
+{
+
+    static const int sides[4][4] = {{-1, 0, 0, 1}, {+1, 0, MESH_SIZE - 1, 1}, {0, -1, 1, 0}, {0, +1, 1, MESH_SIZE - 1}};
+    int apron[CHUNK_SIZE * SECTION_SIZE];
+
+    for (int i = 0; i < 4; i++)
+    {
+
+        Chunk *other = find_chunk(chunk->p + sides[i][0], chunk->q + sides[i][1]);
+        int x = sides[i][2];
+        int z = sides[i][3];
+        int lx = sides[i][0] ? 1 : CHUNK_SIZE;
+        int lz = sides[i][1] ? 1 : CHUNK_SIZE;
+
+        if (!other || !other->ready)
+            continue;
+
+        if (!map_get_box(&other->map, chunk->p * CHUNK_SIZE + x - 1, y0, chunk->q * CHUNK_SIZE + z - 1, lx, SECTION_SIZE, lz, apron, lx, CHUNK_SIZE))
+            continue;
+
+        for (int y = 0; y < SECTION_SIZE; y++)
+        {
+
+            for (int k = 0; k < CHUNK_SIZE; k++)
+            {
+
+                int dx = sides[i][0] ? 0 : k;
+                int dz = sides[i][0] ? k : 0;
+
+                volume[MESH_INDEX(x + dx, y + 1, z + dz)] = apron[y * CHUNK_SIZE + k];
+
+            }
+
+        }
+
+    }
+
+}
+
+static int greedy_faces(GLushort *data, unsigned char *volume, unsigned int *visible, int ox, int oy, int oz)
+{
+
+    static const int axes[6][3] = {{0, 2, 1}, {0, 2, 1}, {1, 0, 2}, {1, 0, 2}, {2, 0, 1}, {2, 0, 1}};
+    int dims[3] = {CHUNK_SIZE, SECTION_SIZE, CHUNK_SIZE};
+    int *mask = (int *)pool_alloc(sizeof(int) * CHUNK_SIZE * CHUNK_SIZE);
+    unsigned int rows[CHUNK_SIZE];
+    float ao[4] = {0.0, 0.0, 0.0, 0.0};
+    float light[4] = {0.0, 0.0, 0.0, 0.0};
+    GLfloat vertices[60];
+    int faces = 0;
+
+    for (int face = 0; face < 6; face++)
+    {
+
+        int sa = axes[face][0];
+        int ua = axes[face][1];
+        int va = axes[face][2];
+
+        for (int s = 0; s < dims[sa]; s++)
+        {
+
+            int pos[3];
+
+            pos[sa] = s;
+
+            for (int v = 0; v < dims[va]; v++)
+            {
+
+                unsigned int bits;
+
+                pos[va] = v;
+
+                if (ua == 0)
+                {
+
+                    rows[v] = visible[(pos[1] * CHUNK_SIZE + pos[2]) * MESH_MASKS + face];
+
+                }
+
+                else
+                {
+
+                    rows[v] = 0;
+
+                    for (int u = 0; u < CHUNK_SIZE; u++)
+                        rows[v] |= ((visible[(v * CHUNK_SIZE + u) * MESH_MASKS + face] >> s) & 1) << u;
+
+                }
+
+                for (bits = rows[v]; bits; bits &= bits - 1)
+                {
+
+                    int u = __builtin_ctz(bits);
+
+                    pos[ua] = u;
+                    mask[v * CHUNK_SIZE + u] = blocks[volume[MESH_INDEX(pos[0] + 1, pos[1] + 1, pos[2] + 1)]][face] + 1;
+
+                }
+
+            }
+
+            for (int v = 0; v < dims[va]; v++)
+            {
+
+                while (rows[v])
+                {
+
+                    int u = __builtin_ctz(rows[v]);
+                    int m = mask[v * CHUNK_SIZE + u];
+                    unsigned int span;
+                    int lu = 1;
+                    int lv = 1;
+
+                    while (u + lu < CHUNK_SIZE && ((rows[v] >> (u + lu)) & 1) && mask[v * CHUNK_SIZE + u + lu] == m)
+                        lu++;
+
+                    span = (lu == 32 ? 0xffffffff : (1u << lu) - 1) << u;
+
+                    while (v + lv < dims[va] && lv < CHUNK_SIZE && (rows[v + lv] & span) == span)
+                    {
+
+                        int k;
+
+                        for (k = 0; k < lu && mask[(v + lv) * CHUNK_SIZE + u + k] == m; k++);
+
+                        if (k < lu)
+                            break;
+
+                        lv++;
+
+                    }
+
+                    for (int dv = 0; dv < lv; dv++)
+                        rows[v + dv] &= ~span;
+
+                    pos[ua] = u;
+                    pos[va] = v;
+
+                    make_quad(vertices, ao, light, face, m - 1, pos[0] + ox + 1, pos[1] + oy + 1, pos[2] + oz + 1, 0.5, lu, lv);
+                    pack_vertices(data + faces * 24, vertices, 6, ox, oy, oz, 0);
+
+                    faces++;
+
+                }
+
+            }
+
+        }
+
+    }
+
+    pool_free(mask, sizeof(int) * CHUNK_SIZE * CHUNK_SIZE);
+
+    return faces;
+
+}
+
+static void compute_section(Chunk *chunk, int section)
+{
+
+    unsigned char *volume = (unsigned char *)pool_calloc(MESH_SIZE * MESH_SIZE * MESH_HEIGHT);
+    unsigned long long *rows = (unsigned long long *)pool_alloc(sizeof(unsigned long long) * 3 * MESH_SIZE * MESH_HEIGHT);
+    unsigned int *visible = (unsigned int *)pool_alloc(sizeof(unsigned int) * MESH_MASKS * CHUNK_SIZE * SECTION_SIZE);
+    unsigned long long *opaque = rows;
+    unsigned long long *cubes = rows + MESH_SIZE * MESH_HEIGHT;
+    unsigned long long *plants = rows + 2 * MESH_SIZE * MESH_HEIGHT;
+    unsigned char kinds[256];
+    int ox = chunk->p * CHUNK_SIZE - 1;
+    int oy = section * SECTION_SIZE - 1;
+    int oz = chunk->q * CHUNK_SIZE - 1;
+    int offset = 0;
+    int total = 0;
+    GLfloat vertices[360];
+    GLushort *data;
+
+    for (int w = 0; w < 256; w++)
+        kinds[w] = (!is_transparent(w)) | ((w && !is_plant(w)) << 1) | (is_plant(w) << 2);
+
+    fill_volume(volume, &chunk->map, chunk->p, chunk->q, oy + 1);
+    fill_apron(volume, chunk, oy + 1);
+
+    for (int y = 0; y < MESH_HEIGHT; y++)
+    {
+
+        for (int z = 0; z < MESH_SIZE; z++)
+        {
+
+            unsigned char *row = volume + MESH_INDEX(0, y, z);
+            unsigned long long o = 0;
+            unsigned long long c = 0;
+            unsigned long long l = 0;
+
+            for (int x = 0; x < MESH_SIZE; x++)
+            {
+
+                unsigned long long k = kinds[row[x]];
+
+                o |= (k & 1) << x;
+                c |= ((k >> 1) & 1) << x;
+                l |= ((k >> 2) & 1) << x;
+
+            }
+
+            opaque[y * MESH_SIZE + z] = o;
+            cubes[y * MESH_SIZE + z] = c;
+            plants[y * MESH_SIZE + z] = l;
+
+        }
+
+    }
+
+    for (int y = 0; y < SECTION_SIZE; y++)
+    {
+
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+
+            int index = (y + 1) * MESH_SIZE + z + 1;
+            unsigned long long *o = opaque + index;
+            unsigned int c = cubes[index] >> 1;
+            unsigned int *v = visible + (y * CHUNK_SIZE + z) * MESH_MASKS;
+
+            v[0] = c & ~(unsigned int)o[0];
+            v[1] = c & ~(unsigned int)(o[0] >> 2);
+            v[2] = c & ~(unsigned int)(o[MESH_SIZE] >> 1);
+            v[3] = c & ~(unsigned int)(o[-MESH_SIZE] >> 1);
+            v[4] = c & ~(unsigned int)(o[-1] >> 1);
+            v[5] = c & ~(unsigned int)(o[1] >> 1);
+            v[6] = plants[index] >> 1;
+            total += __builtin_popcount(v[0]) + __builtin_popcount(v[1]) + __builtin_popcount(v[2]) + __builtin_popcount(v[3]) + __builtin_popcount(v[4]) + __builtin_popcount(v[5]) + __builtin_popcount(v[6]) * 4;
+
+        }
+
+    }
+
+    data = (GLushort *)pool_alloc(sizeof(GLushort) * 24 * total);
 
-    for (int kx = -1; kx <= 1; kx++)
+    for (int y = 0; y < SECTION_SIZE; y++)
     {
 
-        for (int ky = -1; ky <= 1; ky++)
+        for (int z = 0; z < CHUNK_SIZE; z++)
         {
 
-            for (int kz = -1; kz <= 1; kz++)
+            unsigned char *row = volume + MESH_INDEX(1, y + 1, z + 1);
+            unsigned int *v = visible + (y * CHUNK_SIZE + z) * MESH_MASKS;
+            unsigned int bits = v[6];
+            int ey = y + oy + 1;
+            int ez = z + oz + 1;
+
+            while (bits)
             {
 
-                Chunk *chunk;
+                int x = __builtin_ctz(bits);
+                int ex = x + ox + 1;
+                float rotation = noise_simplex2(&g->noise, ex, ez, 4, 0.5, 2) * 360;
 
-                block.x = x + kx;
-                block.y = y + ky;
-                block.z = z + kz;
-                chunk = find_chunk(chunked(block.x), chunked(block.z));
+                bits &= bits - 1;
 
-                if (!chunk)
-                    continue;
+                make_plant(vertices, 0.0, 1.0, ex, ey, ez, 0.5, row[x], rotation);
+                pack_vertices(data + offset, vertices, 24, ox, oy, oz, 1);
 
-                if (!is_obstacle(map_get(&chunk->map, block.x, block.y, block.z)))
-                    continue;
+                offset += 4 * 24;
 
-                if (!aabbcheck(&box, &block))
-                    continue;
+            }
 
-                aabbsweep(&box, &block, &newx, &newy, &newz);
+            if (g->greedy)
+                continue;
 
-            }
+            bits = v[0] | v[1] | v[2] | v[3] | v[4] | v[5];
 
-        }
+            while (bits)
+            {
 
-    }
+                int x = __builtin_ctz(bits);
+                int faces[6];
+                int count = 0;
+
+                float ao[6][4] = {
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0}
+                };
+
+                float light[6][4] = {
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0},
+                    {0.0, 0.0, 0.0, 0.0}
+                };
+
+                bits &= bits - 1;
+
+                for (int f = 0; f < 6; f++)
+                {
 
-    player->box.x += newx;
-    player->box.y += newy;
-    player->box.z += newz;
+                    faces[f] = (v[f] >> x) & 1;
+                    count += faces[f];
 
-}
+                }
 
-static int player_intersects_block(int height, Player *player, int hx, int hy, int hz)
-{
+                make_cube(vertices, ao, light, faces, blocks[row[x]], x + ox + 1, ey, ez, 0.5);
+                pack_vertices(data + offset, vertices, count * 6, ox, oy, oz, 0);
 
-    int nx = roundf(player->box.x);
-    int ny = roundf(player->box.y);
-    int nz = roundf(player->box.z);
+                offset += count * 24;
 
-    for (int i = 0; i < height; i++)
-    {
+            }
 
-        if (nx == hx && ny - i == hy && nz == hz)
-            return 1;
+        }
 
     }
 
-    return 0;
+    if (g->greedy)
+        offset += greedy_faces(data + offset, volume, visible, ox, oy, oz) * 24;
+
+    chunk->counts[section] = offset / 24;
+
+    del_buffer(chunk->buffers[section]);
+
+    chunk->buffers[section] = offset ? gen_buffer(sizeof(GLushort) * offset, data) : 0;
+
+    pool_free(data, sizeof(GLushort) * 24 * total);
+    pool_free(visible, sizeof(unsigned int) * MESH_MASKS * CHUNK_SIZE * SECTION_SIZE);
+    pool_free(rows, sizeof(unsigned long long) * 3 * MESH_SIZE * MESH_HEIGHT);
+    pool_free(volume, MESH_SIZE * MESH_SIZE * MESH_HEIGHT);
 
 }
 
 static void compute_chunk(Chunk *chunk)
 {
 
-    Map *map = &chunk->map;
-    char *opaque = (char *)calloc(XZ_SIZE * XZ_SIZE * Y_SIZE, sizeof(char));
-    int ox = chunk->p * CHUNK_SIZE - 1;
-    int oy = -1;
-    int oz = chunk->q * CHUNK_SIZE - 1;
-    int offset = 0;
-    unsigned int i;
-    GLfloat *data;
+    chunk->faces = 0;
 
-    for (i = 0; i <= map->mask; i++)
+    for (int section = 0; section < SECTION_COUNT; section++)
     {
 
-        MapEntry *entry = map->data + i;
-        int x, y, z;
+        if (chunk->dirty & (1 << section))
+        {
 
-        if (entry->value == 0)
-            continue;
+            if (map_uniform(&chunk->map, section) == 0)
+            {
 
-        if (entry->e.w <= 0)
-            continue;
+                del_buffer(chunk->buffers[section]);
+
+                chunk->buffers[section] = 0;
+                chunk->counts[section] = 0;
+
+            }
+
+            else
+            {
+
+                compute_section(chunk, section);
+
+            }
 
-        x = entry->e.x + map->dx - ox;
-        y = entry->e.y + map->dy - oy;
-        z = entry->e.z + map->dz - oz;
+        }
 
-        opaque[XYZ(x, y, z)] = !is_transparent(entry->e.w);
+        chunk->faces += chunk->counts[section];
 
     }
 
-    chunk->faces = 0;
+}
 
-    for (i = 0; i <= map->mask; i++)
-    {
+static void *worker_run(void *arg)
+{
 
-        MapEntry *entry = map->data + i;
-        int total;
+    pthread_mutex_lock(&g->job_mutex);
 
-        if (entry->value == 0)
-            continue;
+    while (!g->worker_stop)
+    {
 
-        if (entry->e.w <= 0)
-            continue;
+        Job *job;
 
-        if (is_plant(entry->e.w))
+        if (g->pending_head == g->pending_tail)
         {
 
-            total = 4;
+            pthread_cond_wait(&g->job_cond, &g->job_mutex);
+
+            continue;
 
         }
 
-        else
-        {
+        job = g->pending[g->pending_tail++ & (MAX_JOBS - 1)];
 
-            int x = entry->e.x + map->dx - ox;
-            int y = entry->e.y + map->dy - oy;
-            int z = entry->e.z + map->dz - oz;
-            int faces[6];
+        if (!job->cancelled)
+        {
 
-            faces[0] = !opaque[XYZ(x - 1, y, z)];
-            faces[1] = !opaque[XYZ(x + 1, y, z)];
-            faces[2] = !opaque[XYZ(x, y + 1, z)];
-            faces[3] = !opaque[XYZ(x, y - 1, z)];
-            faces[4] = !opaque[XYZ(x, y, z - 1)];
-            faces[5] = !opaque[XYZ(x, y, z + 1)];
-            total = faces[0] + faces[1] + faces[2] + faces[3] + faces[4] + faces[5];
+            pthread_mutex_unlock(&g->job_mutex);
+            job->version = world_generate(&job->map, job->heights, job->noise, job->p, job->q);
+            pthread_mutex_lock(&g->job_mutex);
 
         }
 
-        chunk->faces += total;
+        g->done[g->done_head++ & (MAX_JOBS - 1)] = job;
+
+        pthread_cond_signal(&g->done_cond);
 
     }
 
-    data = malloc(sizeof(GLfloat) * 60 * chunk->faces);
+    pthread_mutex_unlock(&g->job_mutex);
 
-    for (i = 0; i <= map->mask; i++)
-    {
+    return 0;
 
-        MapEntry *entry = map->data + i;
-        int ex, ey, ez;
-        int total;
+}
 
-        if (entry->value == 0)
-            continue;
+static void start_workers(void)
+{
 
-        if (entry->e.w <= 0)
-            continue;
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
 
-        ex = entry->e.x + map->dx;
-        ey = entry->e.y + map->dy;
-        ez = entry->e.z + map->dz;
+    g->worker_count = MAX(1, MIN(MAX_WORKERS, count));
+    g->worker_stop = 0;
 
-        if (is_plant(entry->e.w))
-        {
+    pthread_mutex_init(&g->job_mutex, 0);
+    pthread_cond_init(&g->job_cond, 0);
+    pthread_cond_init(&g->done_cond, 0);
 
-            float rotation = noise_simplex2(ex, ez, 4, 0.5, 2) * 360;
+    for (int i = 0; i < g->worker_count; i++)
+        pthread_create(g->workers + i, 0, worker_run, 0);
 
-            total = 4;
+}
 
-            make_plant(data + offset, 0.0, 1.0, ex, ey, ez, 0.5, entry->e.w, rotation);
+static void free_job(Job *job)
+{
 
-        }
+    map_free(&job->map);
+    free(job);
 
-        else
-        {
+    g->job_count--;
 
-            int x = entry->e.x + map->dx - ox;
-            int y = entry->e.y + map->dy - oy;
-            int z = entry->e.z + map->dz - oz;
-            int faces[6];
-
-            float ao[6][4] = {
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0}
-            };
-
-            float light[6][4] = {
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0},
-                {0.0, 0.0, 0.0, 0.0}
-            };
-
-            faces[0] = !opaque[XYZ(x - 1, y, z)];
-            faces[1] = !opaque[XYZ(x + 1, y, z)];
-            faces[2] = !opaque[XYZ(x, y + 1, z)];
-            faces[3] = !opaque[XYZ(x, y - 1, z)];
-            faces[4] = !opaque[XYZ(x, y, z - 1)];
-            faces[5] = !opaque[XYZ(x, y, z + 1)];
-            total = faces[0] + faces[1] + faces[2] + faces[3] + faces[4] + faces[5];
-
-            if (total == 0)
-                continue;
+}
 
-            make_cube(data + offset, ao, light, faces, blocks[entry->e.w], ex, ey, ez, 0.5);
+static void stop_workers(void)
+{
 
-        }
+    pthread_mutex_lock(&g->job_mutex);
 
-        offset += total * 60;
+    g->worker_stop = 1;
 
-    }
+    pthread_cond_broadcast(&g->job_cond);
+    pthread_mutex_unlock(&g->job_mutex);
 
-    del_buffer(chunk->buffer);
+    for (int i = 0; i < g->worker_count; i++)
+        pthread_join(g->workers[i], 0);
 
-    chunk->buffer = gen_buffer(sizeof(GLfloat) * 60 * chunk->faces, data);
+    while (g->pending_head != g->pending_tail)
+        free_job(g->pending[g->pending_tail++ & (MAX_JOBS - 1)]);
 
-    free(data);
-    free(opaque);
+    while (g->done_head != g->done_tail)
+        free_job(g->done[g->done_tail++ & (MAX_JOBS - 1)]);
+
+    pthread_cond_destroy(&g->done_cond);
+    pthread_cond_destroy(&g->job_cond);
+    pthread_mutex_destroy(&g->job_mutex);
 
 }
 
-static void createworld(Map *map, int p, int q)
+static Job *submit_job(int p, int q)
 {
 
-    unsigned int dx;
-    unsigned int dz;
+    Job *job = (Job *)malloc(sizeof(Job));
 
-    for (dx = 0; dx < CHUNK_SIZE; dx++)
-    {
+    job->p = p;
+    job->q = q;
+    job->cancelled = 0;
+    job->noise = &g->noise;
 
-        for (dz = 0; dz < CHUNK_SIZE; dz++)
-        {
+    world_alloc(&job->map, p, q);
+    pthread_mutex_lock(&g->job_mutex);
+
+    g->pending[g->pending_head++ & (MAX_JOBS - 1)] = job;
+    g->job_count++;
 
-            int x = p * CHUNK_SIZE + dx;
-            int z = q * CHUNK_SIZE + dz;
-            float f = noise_simplex2(x * 0.01, z * 0.01, 4, 0.5, 2);
-            float g = noise_simplex2(-x * 0.01, -z * 0.01, 2, 0.9, 2);
-            int mh = g * 32 + 16;
-            int h = f * mh;
-            int y;
+    pthread_cond_signal(&g->job_cond);
+    pthread_mutex_unlock(&g->job_mutex);
 
-            if (h <= 12)
-                h = 12;
+    return job;
 
-            for (y = 0; y < 10; y++)
-                map_set(map, x, y, z, CEMENT);
+}
 
-            for (y = 10; y < 12; y++)
-                map_set(map, x, y, z, SAND);
+static void cancel_job(Job *job)
+{
 
-            for (y = 12; y < h - 1; y++)
-                map_set(map, x, y, z, DIRT);
+    pthread_mutex_lock(&g->job_mutex);
 
-            if (h > 12)
-                map_set(map, x, h - 1, z, GRASS);
+    job->cancelled = 1;
 
-            if (h > 12)
-            {
+    pthread_mutex_unlock(&g->job_mutex);
 
-                if (noise_simplex2(-x * 0.1, z * 0.1, 4, 0.8, 2) > 0.6)
-                {
+}
 
-                    map_set(map, x, h, z, TALL_GRASS);
+static void apply_edits(Chunk *chunk)
+{
 
-                }
+    if (chunk && chunk->ready && world_apply(&chunk->map, chunk->heights, chunk->p, chunk->q, &chunk->version))
+        chunk->dirty = SECTION_ALL;
 
-                if (noise_simplex2(x * 0.05, -z * 0.05, 4, 0.8, 2) > 0.7)
-                {
+}
 
-                    int w = YELLOW_FLOWER + noise_simplex2(x * 0.1, z * 0.1, 4, 0.8, 2) * 7;
+static int check_workers(void)
+{
 
-                    map_set(map, x, h, z, w);
+    Job *jobs[MAX_JOBS];
+    int count = 0;
 
-                }
+    pthread_mutex_lock(&g->job_mutex);
 
-            }
+    while (g->done_head != g->done_tail)
+        jobs[count++] = g->done[g->done_tail++ & (MAX_JOBS - 1)];
+
+    pthread_mutex_unlock(&g->job_mutex);
+
+    for (int i = 0; i < count; i++)
+    {
 
-            for (y = 64; y < 72; y++)
+        Job *job = jobs[i];
+        Chunk *chunk = job->cancelled ? 0 : find_chunk(job->p, job->q);
+
+        if (chunk)
+        {
+
+            map_free(&chunk->map);
+            memcpy(&chunk->map, &job->map, sizeof(Map));
+            memcpy(chunk->heights, job->heights, sizeof(chunk->heights));
+            memset(&job->map, 0, sizeof(Map));
+
+            chunk->ready = 1;
+            chunk->version = job->version;
+            chunk->dirty = SECTION_ALL;
+            chunk->job = 0;
+
+            dirty_neighbors(job->p, job->q);
+
+            for (int dp = -1; dp <= 1; dp++)
             {
 
-                if (noise_simplex3(x * 0.01, y * 0.1, z * 0.01, 8, 0.5, 2) > 0.75)
-                    map_set(map, x, y, z, CLOUD);
+                for (int dq = -1; dq <= 1; dq++)
+                    apply_edits(find_chunk(job->p + dp, job->q + dq));
 
             }
 
         }
 
+        free_job(job);
+
+    }
+
+    return count;
+
+}
+
+static void wait_chunk(int p, int q)
+{
+
+    Chunk *chunk = find_chunk(p, q);
+
+    while (chunk && !chunk->ready)
+    {
+
+        pthread_mutex_lock(&g->job_mutex);
+
+        while (g->done_head == g->done_tail)
+            pthread_cond_wait(&g->done_cond, &g->job_mutex);
+
+        pthread_mutex_unlock(&g->job_mutex);
+        check_workers();
+
     }
 
 }
@@ -973,53 +1621,88 @@ static void create_chunk(Chunk *chunk, int p, int q)
     chunk->p = p;
     chunk->q = q;
     chunk->faces = 0;
-    chunk->buffer = 0;
-    chunk->dirty = 1;
+    chunk->dirty = SECTION_ALL;
+    chunk->ready = 1;
+    chunk->version = 0;
+    chunk->job = 0;
+
+    memset(chunk->counts, 0, sizeof(chunk->counts));
+    memset(chunk->buffers, 0, sizeof(chunk->buffers));
+
+    world_alloc(&chunk->map, p, q);
+
+    if (cold_load(&chunk->map, chunk->heights, p, q, &chunk->version) || bake_load(&chunk->map, chunk->heights, p, q))
+    {
+
+        world_apply(&chunk->map, chunk->heights, p, q, &chunk->version);
+        dirty_neighbors(p, q);
+
+        return;
+
+    }
+
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++)
+        chunk->heights[i] = -1;
+
+    chunk->dirty = 0;
+    chunk->ready = 0;
+    chunk->job = submit_job(p, q);
 
-    map_alloc(&chunk->map, chunk->p * CHUNK_SIZE, 0, chunk->q * CHUNK_SIZE, 0x7fff);
-    createworld(&chunk->map, chunk->p, chunk->q);
+}
+
+static void del_chunk_buffers(Chunk *chunk)
+{
+
+    for (int i = 0; i < SECTION_COUNT; i++)
+        del_buffer(chunk->buffers[i]);
 
 }
 
 static void delete_chunks()
 {
 
-    int count = g->chunk_count;
+    int p = chunked(g->player.box.x);
+    int q = chunked(g->player.box.z);
+    int i = 0;
 
-    for (int i = 0; i < count; i++)
+    while (i < g->chunk_count)
     {
 
         Chunk *chunk = g->chunks + i;
 
-        int p = chunked(g->player.box.x);
-        int q = chunked(g->player.box.z);
-        int delete = 1;
-
         if (chunk_distance(chunk, p, q) < g->delete_radius)
         {
 
-            delete = 0;
+            i++;
 
-            break;
+            continue;
 
         }
 
-        if (delete)
-        {
+        remove_chunk_index(chunk->p, chunk->q);
+        dirty_neighbors(chunk->p, chunk->q);
 
-            map_free(&chunk->map);
-            del_buffer(chunk->buffer);
+        if (chunk->job)
+            cancel_job(chunk->job);
+
+        if (chunk->ready)
+            cold_store(&chunk->map, chunk->p, chunk->q, chunk->version);
+
+        map_free(&chunk->map);
+        del_chunk_buffers(chunk);
+
+        if (i != --g->chunk_count)
+        {
 
-            Chunk *other = g->chunks + (--count);
+            Chunk *other = g->chunks + g->chunk_count;
 
             memcpy(chunk, other, sizeof(Chunk));
+            insert_chunk_index(chunk->p, chunk->q, i);
 
         }
 
     }
 
-    g->chunk_count = count;
-
 }
 
 static void delete_all_chunks()
@@ -1030,11 +1713,16 @@ static void delete_all_chunks()
 
         Chunk *chunk = g->chunks + i;
 
+        if (chunk->job)
+            cancel_job(chunk->job);
+
         map_free(&chunk->map);
-        del_buffer(chunk->buffer);
+        del_chunk_buffers(chunk);
 
     }
 
+    memset(g->chunk_index, 0, sizeof(g->chunk_index));
+
     g->chunk_count = 0;
 
 }
@@ -1058,20 +1746,22 @@ static void load_chunks(Player *player, int radius, int max)
             if (!chunk)
             {
 
-                if (g->chunk_count < MAX_CHUNKS)
+                if (g->chunk_count < MAX_CHUNKS && g->job_count < MAX_JOBS)
                 {
 
-                    chunk = g->chunks + g->chunk_count++;
+                    chunk = g->chunks + g->chunk_count;
 
                     create_chunk(chunk, a, b);
+                    insert_chunk_index(a, b, g->chunk_count++);
 
                 }
 
             }
 
-            if (chunk && chunk->dirty)
+            if (chunk && chunk->ready && chunk->dirty && !neighbors_pending(chunk))
             {
 
+                map_compact(&chunk->map);
                 compute_chunk(chunk);
 
                 chunk->dirty = 0;
@@ -1092,7 +1782,42 @@ static int getblock(int x, int y, int z)
 
     Chunk *chunk = find_chunk(chunked(x), chunked(z));
 
-    return (chunk) ? map_get(&chunk->map, x, y, z) : 0;
+    return (chunk && chunk->ready) ? map_get(&chunk->map, x, y, z) : 0;
+
+}
+
+static int chunk_height_at(Chunk *chunk, int x, int z)
+{
+
+    return chunk->heights[(z - chunk->q * CHUNK_SIZE) * CHUNK_SIZE + (x - chunk->p * CHUNK_SIZE)];
+
+}
+
+static void update_height(Chunk *chunk, int x, int y, int z, int w)
+{
+
+    short *height = chunk->heights + (z - chunk->q * CHUNK_SIZE) * CHUNK_SIZE + (x - chunk->p * CHUNK_SIZE);
+
+    if (w)
+    {
+
+        if (y > *height)
+            *height = y;
+
+    }
+
+    else if (y == *height)
+    {
+
+        int column[Y_SIZE];
+
+        map_get_column(&chunk->map, x, 0, z, y, column);
+
+        while (--y >= 0 && !column[y]);
+
+        *height = y;
+
+    }
 
 }
 
@@ -1101,16 +1826,45 @@ static void setblock(int x, int y, int z, int w)
 
     Chunk *chunk = find_chunk(chunked(x), chunked(z));
 
-    if (chunk && map_set(&chunk->map, x, y, z, w))
-        chunk->dirty = 1;
+    if (chunk && chunk->ready && map_set(&chunk->map, x, y, z, w))
+    {
+
+        int lx = x - chunk->p * CHUNK_SIZE;
+        int lz = z - chunk->q * CHUNK_SIZE;
+        int sections = 1 << (y / SECTION_SIZE);
+
+        update_height(chunk, x, y, z, w);
+
+        chunk->dirty |= sections;
+
+        if (y % SECTION_SIZE == 0 && y > 0)
+            chunk->dirty |= sections >> 1;
+
+        if (y % SECTION_SIZE == SECTION_SIZE - 1 && y < Y_SIZE - 1)
+            chunk->dirty |= sections << 1;
+
+        if (lx == 0)
+            dirty_chunk(chunk->p - 1, chunk->q, sections);
+
+        if (lx == CHUNK_SIZE - 1)
+            dirty_chunk(chunk->p + 1, chunk->q, sections);
+
+        if (lz == 0)
+            dirty_chunk(chunk->p, chunk->q - 1, sections);
+
+        if (lz == CHUNK_SIZE - 1)
+            dirty_chunk(chunk->p, chunk->q + 1, sections);
+
+    }
 
 }
 
-static void render_chunks(Attrib *attrib, Player *player)
+static int render_chunks(Attrib *attrib, Player *player)
 {
 
     int p = chunked(player->box.x);
     int q = chunked(player->box.z);
+    int faces = 0;
     float matrix[16];
     float planes[6][4];
 
@@ -1126,6 +1880,7 @@ static void render_chunks(Attrib *attrib, Player *player)
     glUniform1f(attrib->extra3, g->render_radius * CHUNK_SIZE);
     glUniform1i(attrib->extra4, g->ortho);
     glUniform1f(attrib->timer, time_of_day());
+    glUniform1i(attrib->extra5, 1);
 
     for (int i = 0; i < g->chunk_count; i++)
     {
@@ -1135,10 +1890,23 @@ static void render_chunks(Attrib *attrib, Player *player)
         if (chunk_distance(chunk, p, q) > g->render_radius)
             continue;
 
-        draw_triangles_3d_ao(attrib, chunk->buffer, chunk->faces * 6);
+        for (int section = 0; section < SECTION_COUNT; section++)
+        {
+
+            if (!chunk->counts[section])
+                continue;
+
+            glUniform3f(attrib->extra6, chunk->p * CHUNK_SIZE - 1, section * SECTION_SIZE - 1, chunk->q * CHUNK_SIZE - 1);
+            draw_triangles_packed(attrib, chunk->buffers[section], chunk->counts[section] * 6);
+
+        }
+
+        faces += chunk->faces;
 
     }
 
+    return faces;
+
 }
 
 static void render_sky(Attrib *attrib, Player *player, GLuint buffer)
@@ -1190,6 +1958,7 @@ static void render_item(Attrib *attrib)
     glUniform3f(attrib->camera, 0, 0, 5);
     glUniform1i(attrib->sampler, 0);
     glUniform1f(attrib->timer, time_of_day());
+    glUniform1i(attrib->extra5, 0);
 
     if (is_plant(w))
     {
@@ -1271,6 +2040,25 @@ static void parse_command(const char *buffer)
 
     }
 
+    else if (strcmp(buffer, "/stats") == 0)
+    {
+
+        g->show_stats = !g->show_stats;
+
+    }
+
+    else if (strcmp(buffer, "/greedy") == 0)
+    {
+
+        g->greedy = !g->greedy;
+
+        for (int i = 0; i < g->chunk_count; i++)
+            g->chunks[i].dirty = SECTION_ALL;
+
+        add_message(g->greedy ? "Greedy meshing on." : "Greedy meshing off.");
+
+    }
+
 }
 
 static void addblock(void)
@@ -1722,6 +2510,8 @@ static void loadshaders(void)
     g->block_attrib.extra2 = glGetUniformLocation(program, "daylight");
     g->block_attrib.extra3 = glGetUniformLocation(program, "fog_distance");
     g->block_attrib.extra4 = glGetUniformLocation(program, "ortho");
+    g->block_attrib.extra5 = glGetUniformLocation(program, "vertex_format");
+    g->block_attrib.extra6 = glGetUniformLocation(program, "origin");
     g->block_attrib.camera = glGetUniformLocation(program, "camera");
     g->block_attrib.timer = glGetUniformLocation(program, "timer");
 
@@ -1847,10 +2637,7 @@ static void loadtextures(void)
 static void initrng(void)
 {
 
-    struct mtwist_state state;
-
-    mtwist_seed1(&state, 1234);
-    noise_seed(&state);
+    noise_seed(&g->noise, 1234);
 
 }
 
@@ -1892,6 +2679,7 @@ int main(int argc, char **argv)
     loadtextures();
     loadshaders();
     initrng();
+    bake_open(BAKE_FILE, g->noise.seed);
 
     double last_update = glfwGetTime();
     int running = 1;
@@ -1904,6 +2692,7 @@ int main(int argc, char **argv)
     g->frames = 0;
     g->since = 0;
     g->render_radius = RENDER_CHUNK_RADIUS;
+    g->greedy = GREEDY_MESHING;
     g->delete_radius = RENDER_CHUNK_RADIUS + 4;
     g->scale = g->width / winw;
     g->scale = MAX(1, g->scale);
@@ -1914,7 +2703,14 @@ int main(int argc, char **argv)
 
     GLuint sky_buffer = gen_sky_buffer();
 
+    start_workers();
     load_chunks(&g->player, g->render_radius, ((g->render_radius * 2) + 1) * ((g->render_radius * 2) + 1));
+    wait_chunk(chunked(g->player.box.x), chunked(g->player.box.z));
+
+    Chunk *spawn = find_chunk(chunked(g->player.box.x), chunked(g->player.box.z));
+
+    if (spawn)
+        g->player.box.y = chunk_height_at(spawn, roundf(g->player.box.x), roundf(g->player.box.z)) + 2;
 
     while (running)
     {
@@ -1937,14 +2733,20 @@ int main(int argc, char **argv)
         }
 
         handle_movement();
+        check_workers();
         delete_chunks();
         load_chunks(&g->player, 1, 9);
         load_chunks(&g->player, g->render_radius, 1);
         render_sky(&g->sky_attrib, &g->player, sky_buffer);
-        render_chunks(&g->block_attrib, &g->player);
+        int faces = render_chunks(&g->block_attrib, &g->player);
         render_crosshairs(&g->line_attrib);
         render_item(&g->block_attrib);
 
+        MapStats map_frame;
+        PoolStats pool_frame;
+        ColdStats cold_frame;
+        BakeStats bake_frame;
+        WorldStats world_frame;
         char text_buffer[1024];
         float ts = 12 * g->scale;
         float tx = ts / 2;
@@ -1955,11 +2757,62 @@ int main(int argc, char **argv)
         hour = hour % 12;
         hour = hour ? hour : 12;
 
+        map_stats(&map_frame);
+        pool_stats(&pool_frame);
+        cold_stats(&cold_frame);
+        bake_stats(&bake_frame);
+        world_stats(&world_frame);
+
         snprintf(text_buffer, 1024, "(%d, %d) (%.2f, %.2f, %.2f) %d%cm %dfps", chunked(g->player.box.x), chunked(g->player.box.z), g->player.box.x, g->player.box.y, g->player.box.z, hour, am_pm, g->fps);
         render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
 
         ty -= ts * 2;
 
+        if (g->show_stats)
+        {
+
+            snprintf(text_buffer, 1024, "mesh %d faces %s", faces, g->greedy ? "greedy" : "culled");
+            render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+
+            ty -= ts * 2;
+
+            snprintf(text_buffer, 1024, "rehash %u steps %u buckets %u grows %u shrinks", map_frame.rehash_steps, map_frame.rehash_buckets, map_frame.grows, map_frame.shrinks);
+            render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+
+            ty -= ts * 2;
+
+            snprintf(text_buffer, 1024, "pool %u allocs %u frees %u hits %u misses %ukb retained", pool_frame.allocs, pool_frame.frees, pool_frame.hits, pool_frame.misses, pool_frame.retained / 1024);
+            render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+
+            ty -= ts * 2;
+
+            snprintf(text_buffer, 1024, "cold %u stores %u hits %u misses %u evictions %u chunks %ukb", cold_frame.stores, cold_frame.hits, cold_frame.misses, cold_frame.evictions, cold_frame.count, cold_frame.bytes / 1024);
+            render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+
+            ty -= ts * 2;
+
+            snprintf(text_buffer, 1024, "bake %u loads %u misses %ukb", bake_frame.loads, bake_frame.misses, bake_frame.bytes / 1024);
+            render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+
+            ty -= ts * 2;
+
+            snprintf(text_buffer, 1024, "world %u chunks %u edits", world_frame.chunks, world_frame.edits);
+
+            for (int i = 0; i < WORLD_STAGES; i++)
+            {
+
+                int length = strlen(text_buffer);
+
+                snprintf(text_buffer + length, 1024 - length, " %s %.0fms/%u", world_stage_name(i), world_frame.ns[i] / 1000000.0, world_frame.skips[i]);
+
+            }
+
+            render_text(&g->text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+
+            ty -= ts * 2;
+
+        }
+
         for (int i = 0; i < MAX_MESSAGES; i++)
         {
 
@@ -2002,6 +2855,11 @@ int main(int argc, char **argv)
 
     del_buffer(sky_buffer);
     delete_all_chunks();
+    stop_workers();
+    world_clear();
+    cold_clear();
+    bake_close();
+    pool_trim();
     glfwTerminate();
 
     return 0;
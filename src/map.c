@@ -1,7 +1,16 @@
 #include <stdlib.h>
 #include <string.h>
+#include "config.h"
+#include "pool.h"
+#include "palette.h"
 #include "map.h"
 
+#define MAP_MIN_MASK                    0xff
+#define MAP_BUILDER_VOLUME              (CHUNK_SIZE * Y_SIZE * CHUNK_SIZE)
+#define MAP_BUILDER_INDEX(x, y, z)      (((y) * CHUNK_SIZE + (z)) * CHUNK_SIZE + (x))
+
+static MapStats stats;
+
 static int hashkey(int key)
 {
 
@@ -23,6 +32,198 @@ static int hash(int x, int y, int z)
 
 }
 
+static MapEntry *lookup(MapEntry *data, unsigned int mask, unsigned int index, int x, int y, int z)
+{
+
+    MapEntry *entry;
+
+    index &= mask;
+    entry = data + index;
+
+    while (entry->value)
+    {
+
+        if (entry->e.x == x && entry->e.y == y && entry->e.z == z)
+            return entry;
+
+        index = (index + 1) & mask;
+        entry = data + index;
+
+    }
+
+    return entry;
+
+}
+
+static void moved(unsigned int count)
+{
+
+    if (!count)
+        return;
+
+    __atomic_fetch_add(&stats.rehash_steps, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.rehash_buckets, count, __ATOMIC_RELAXED);
+
+}
+
+static void migrate(Map *map, unsigned int count)
+{
+
+    unsigned int buckets = 0;
+
+    while (count-- && map->migrate <= map->old_mask)
+    {
+
+        MapEntry *entry = map->old + map->migrate++;
+        int x, y, z;
+
+        if (entry->value == 0)
+            continue;
+
+        x = entry->e.x + map->dx;
+        y = entry->e.y + map->dy;
+        z = entry->e.z + map->dz;
+
+        *lookup(map->data, map->mask, hash(x, y, z), entry->e.x, entry->e.y, entry->e.z) = *entry;
+
+        buckets++;
+
+    }
+
+    moved(buckets);
+
+    if (map->migrate > map->old_mask)
+    {
+
+        pool_free(map->old, (map->old_mask + 1) * sizeof(MapEntry));
+
+        map->old = 0;
+        map->old_mask = 0;
+        map->migrate = 0;
+
+    }
+
+}
+
+static void evacuate(Map *map, unsigned int index)
+{
+
+    unsigned int buckets = 0;
+
+    while (map->old[(index - 1) & map->old_mask].value)
+        index = (index - 1) & map->old_mask;
+
+    for (; map->old[index].value; index = (index + 1) & map->old_mask)
+    {
+
+        MapEntry *entry = map->old + index;
+
+        if (index >= map->migrate)
+        {
+
+            int x = entry->e.x + map->dx;
+            int y = entry->e.y + map->dy;
+            int z = entry->e.z + map->dz;
+
+            *lookup(map->data, map->mask, hash(x, y, z), entry->e.x, entry->e.y, entry->e.z) = *entry;
+
+            buckets++;
+
+        }
+
+        entry->value = 0;
+
+    }
+
+    moved(buckets);
+
+}
+
+static void erase(Map *map, MapEntry *entry)
+{
+
+    unsigned int index = entry - map->data;
+    unsigned int next = (index + 1) & map->mask;
+
+    entry->value = 0;
+
+    while (map->data[next].value)
+    {
+
+        MapEntry *other = map->data + next;
+        unsigned int home = hash(other->e.x + map->dx, other->e.y + map->dy, other->e.z + map->dz) & map->mask;
+
+        if (((next - home) & map->mask) >= ((next - index) & map->mask))
+        {
+
+            map->data[index] = *other;
+            other->value = 0;
+            index = next;
+
+        }
+
+        next = (next + 1) & map->mask;
+
+    }
+
+    map->size--;
+
+}
+
+static void rebuild(Map *map, unsigned int mask)
+{
+
+    MapEntry *data = map->data;
+    unsigned int old_mask = map->mask;
+    unsigned int i;
+
+    map->mask = mask;
+    map->data = (MapEntry *)pool_calloc((map->mask + 1) * sizeof(MapEntry));
+
+    for (i = 0; i <= old_mask; i++)
+    {
+
+        MapEntry *entry = data + i;
+        int x, y, z;
+
+        if (entry->value == 0)
+            continue;
+
+        x = entry->e.x + map->dx;
+        y = entry->e.y + map->dy;
+        z = entry->e.z + map->dz;
+
+        *lookup(map->data, map->mask, hash(x, y, z), entry->e.x, entry->e.y, entry->e.z) = *entry;
+
+    }
+
+    pool_free(data, (old_mask + 1) * sizeof(MapEntry));
+
+}
+
+static void grow(Map *map)
+{
+
+    if (!MAP_REHASH_BUCKETS)
+    {
+
+        map_grow(map);
+
+        return;
+
+    }
+
+    if (map->old)
+        migrate(map, map->old_mask + 1);
+
+    map->old = map->data;
+    map->old_mask = map->mask;
+    map->migrate = 0;
+    map->mask = (map->mask << 1) | 1;
+    map->data = (MapEntry *)pool_calloc((map->mask + 1) * sizeof(MapEntry));
+
+}
+
 void map_alloc(Map *map, int dx, int dy, int dz, int mask)
 {
 
@@ -31,64 +232,175 @@ void map_alloc(Map *map, int dx, int dy, int dz, int mask)
     map->dz = dz;
     map->mask = mask;
     map->size = 0;
-    map->data = (MapEntry *)calloc(map->mask + 1, sizeof(MapEntry));
+    map->data = (MapEntry *)pool_calloc((map->mask + 1) * sizeof(MapEntry));
+    map->old = 0;
+    map->old_mask = 0;
+    map->migrate = 0;
+    map->palette = 0;
+
+}
+
+void map_alloc_palette(Map *map, int dx, int dy, int dz)
+{
+
+    map->dx = dx;
+    map->dy = dy;
+    map->dz = dz;
+    map->mask = 0;
+    map->size = 0;
+    map->data = 0;
+    map->old = 0;
+    map->old_mask = 0;
+    map->migrate = 0;
+    map->palette = (Palette *)pool_alloc(sizeof(Palette));
+
+    palette_alloc(map->palette);
 
 }
 
 void map_free(Map *map)
 {
 
-    free(map->data);
+    if (map->palette)
+    {
+
+        palette_free(map->palette);
+        pool_free(map->palette, sizeof(Palette));
+
+    }
+
+    if (map->old)
+        pool_free(map->old, (map->old_mask + 1) * sizeof(MapEntry));
+
+    if (map->data)
+        pool_free(map->data, (map->mask + 1) * sizeof(MapEntry));
 
 }
 
 void map_copy(Map *dst, Map *src)
 {
 
+    if (src->old)
+        migrate(src, src->old_mask + 1);
+
     dst->dx = src->dx;
     dst->dy = src->dy;
     dst->dz = src->dz;
     dst->mask = src->mask;
     dst->size = src->size;
-    dst->data = (MapEntry *)calloc(dst->mask + 1, sizeof(MapEntry));
+    dst->data = 0;
+    dst->old = 0;
+    dst->old_mask = 0;
+    dst->migrate = 0;
+    dst->palette = 0;
+
+    if (src->palette)
+    {
+
+        dst->palette = (Palette *)pool_alloc(sizeof(Palette));
+
+        palette_copy(dst->palette, src->palette);
+
+    }
+
+    else
+    {
+
+        dst->data = (MapEntry *)pool_alloc((dst->mask + 1) * sizeof(MapEntry));
+
+        memcpy(dst->data, src->data, (dst->mask + 1) * sizeof(MapEntry));
 
-    memcpy(dst->data, src->data, (dst->mask + 1) * sizeof(MapEntry));
+    }
+
+}
+
+void map_snapshot(Map *dst, Map *src)
+{
+
+    if (!src->palette)
+    {
+
+        map_copy(dst, src);
+
+        return;
+
+    }
+
+    dst->dx = src->dx;
+    dst->dy = src->dy;
+    dst->dz = src->dz;
+    dst->mask = 0;
+    dst->size = 0;
+    dst->data = 0;
+    dst->old = 0;
+    dst->old_mask = 0;
+    dst->migrate = 0;
+    dst->palette = (Palette *)pool_alloc(sizeof(Palette));
+
+    palette_snapshot(dst->palette, src->palette);
 
 }
 
 int map_set(Map *map, int x, int y, int z, int w)
 {
 
-    unsigned int index = hash(x, y, z) & map->mask;
+    unsigned int index;
+    MapEntry *entry;
+
+    if (map->palette)
+        return palette_set(map->palette, x - map->dx, y - map->dy, z - map->dz, w);
+
+    index = hash(x, y, z);
 
     x -= map->dx;
     y -= map->dy;
     z -= map->dz;
 
-    MapEntry *entry = map->data + index;
+    if (map->old)
+        migrate(map, MAP_REHASH_BUCKETS);
 
-    int overwrite = 0;
+    entry = lookup(map->data, map->mask, index, x, y, z);
 
-    while (entry->value)
+    if (!entry->value && map->old)
     {
 
-        if (entry->e.x == x && entry->e.y == y && entry->e.z == z)
+        MapEntry *old = lookup(map->old, map->old_mask, index, x, y, z);
+
+        if (old->value && old - map->old >= map->migrate)
         {
 
-            overwrite = 1;
+            if (w)
+            {
 
-            break;
+                entry = old;
 
-        }
+            }
+
+            else
+            {
+
+                evacuate(map, old - map->old);
 
-        index = (index + 1) & map->mask;
-        entry = map->data + index;
+                entry = lookup(map->data, map->mask, index, x, y, z);
+
+            }
+
+        }
 
     }
 
-    if (overwrite)
+    if (entry->value)
     {
 
+        if (!w)
+        {
+
+            erase(map, entry);
+
+            return 1;
+
+        }
+
         if (entry->e.w != w)
         {
 
@@ -110,7 +422,7 @@ int map_set(Map *map, int x, int y, int z, int w)
         map->size++;
 
         if (map->size * 2 > map->mask)
-            map_grow(map);
+            grow(map);
 
         return 1;
 
@@ -123,7 +435,13 @@ int map_set(Map *map, int x, int y, int z, int w)
 int map_get(Map *map, int x, int y, int z)
 {
 
-    unsigned int index = hash(x, y, z) & map->mask;
+    unsigned int index;
+    MapEntry *entry;
+
+    if (map->palette)
+        return palette_get(map->palette, x - map->dx, y - map->dy, z - map->dz);
+
+    index = hash(x, y, z);
 
     x -= map->dx;
     y -= map->dy;
@@ -133,57 +451,307 @@ int map_get(Map *map, int x, int y, int z)
     if (y < 0 || y > 255) return 0;
     if (z < 0 || z > 255) return 0;
 
-    MapEntry *entry = map->data + index;
+    entry = lookup(map->data, map->mask, index, x, y, z);
 
-    while (entry->value)
+    if (!entry->value && map->old)
     {
 
-        if (entry->e.x == x && entry->e.y == y && entry->e.z == z)
-            return entry->e.w;
+        MapEntry *old = lookup(map->old, map->old_mask, index, x, y, z);
 
-        index = (index + 1) & map->mask;
-        entry = map->data + index;
+        if (old - map->old >= map->migrate)
+            entry = old;
 
     }
 
-    return 0;
+    return entry->e.w;
 
 }
 
-void map_grow(Map *map)
+int map_get_box(Map *map, int x, int y, int z, int lx, int ly, int lz, int *out, int pitch, int slice)
+{
+
+    int count = 0;
+    int dx, dy, dz;
+
+    if (map->palette)
+        return palette_get_box(map->palette, x - map->dx, y - map->dy, z - map->dz, lx, ly, lz, out, pitch, slice);
+
+    for (dy = 0; dy < ly; dy++)
+    {
+
+        for (dz = 0; dz < lz; dz++)
+        {
+
+            int *row = out + dy * slice + dz * pitch;
+
+            for (dx = 0; dx < lx; dx++)
+            {
+
+                row[dx] = map_get(map, x + dx, y + dy, z + dz);
+                count += row[dx] != 0;
+
+            }
+
+        }
+
+    }
+
+    return count;
+
+}
+
+int map_get_column(Map *map, int x, int y, int z, int ly, int *out)
+{
+
+    return map_get_box(map, x, y, z, 1, ly, 1, out, 1, 1);
+
+}
+
+int map_get_neighbors(Map *map, int x, int y, int z, int *out)
+{
+
+    return map_get_box(map, x - 1, y - 1, z - 1, 3, 3, 3, out, 3, 9);
+
+}
+
+int map_uniform(Map *map, int section)
+{
+
+    if (map->palette)
+        return palette_uniform(map->palette, section);
+
+    return -1;
+
+}
+
+int map_next(Map *map, unsigned int *index, int *x, int *y, int *z, int *w)
 {
 
-    Map new_map;
     unsigned int i;
 
-    new_map.dx = map->dx;
-    new_map.dy = map->dy;
-    new_map.dz = map->dz;
-    new_map.mask = (map->mask << 1) | 1;
-    new_map.size = 0;
-    new_map.data = (MapEntry *)calloc(new_map.mask + 1, sizeof(MapEntry));
+    if (map->palette)
+    {
+
+        if (!palette_next(map->palette, index, x, y, z, w))
+            return 0;
+
+        *x += map->dx;
+        *y += map->dy;
+        *z += map->dz;
+
+        return 1;
 
-    for (i = 0; i <= map->mask; i++)
+    }
+
+    for (i = *index; i <= map->mask + (map->old ? map->old_mask + 1 : 0); i++)
     {
 
-        MapEntry *entry = map->data + i;
-        int x, y, z;
+        MapEntry *entry;
+
+        if (i <= map->mask)
+        {
+
+            entry = map->data + i;
+
+        }
+
+        else
+        {
+
+            if (i - map->mask - 1 < map->migrate)
+                continue;
+
+            entry = map->old + i - map->mask - 1;
+
+        }
 
         if (entry->value == 0)
             continue;
 
-        x = entry->e.x + map->dx;
-        y = entry->e.y + map->dy;
-        z = entry->e.z + map->dz;
+        *x = entry->e.x + map->dx;
+        *y = entry->e.y + map->dy;
+        *z = entry->e.z + map->dz;
+        *w = entry->e.w;
+        *index = i + 1;
+
+        return 1;
+
+    }
+
+    *index = i;
+
+    return 0;
+
+}
 
-        map_set(&new_map, x, y, z, entry->e.w);
+void map_grow(Map *map)
+{
+
+    if (map->old)
+        migrate(map, map->old_mask + 1);
+
+    __atomic_fetch_add(&stats.grows, 1, __ATOMIC_RELAXED);
+
+    rebuild(map, (map->mask << 1) | 1);
+
+}
+
+int map_compact(Map *map)
+{
+
+    unsigned int mask;
+
+    if (map->palette)
+        return palette_compact(map->palette);
+
+    if (map->old)
+        migrate(map, map->old_mask + 1);
+
+    mask = map->mask;
+
+    while (mask > MAP_MIN_MASK && map->size * 8 <= mask)
+        mask >>= 1;
+
+    if (mask == map->mask)
+        return 0;
+
+    __atomic_fetch_add(&stats.shrinks, 1, __ATOMIC_RELAXED);
+
+    rebuild(map, mask);
+
+    return 1;
+
+}
+
+void map_builder_alloc(MapBuilder *builder, int dx, int dy, int dz)
+{
+
+    builder->dx = dx;
+    builder->dy = dy;
+    builder->dz = dz;
+    builder->height = 0;
+    builder->blocks = (unsigned char *)pool_calloc(MAP_BUILDER_VOLUME);
+
+}
+
+void map_builder_free(MapBuilder *builder)
+{
+
+    pool_free(builder->blocks, MAP_BUILDER_VOLUME);
+
+}
+
+void map_builder_set(MapBuilder *builder, int x, int y, int z, int w)
+{
+
+    map_builder_fill(builder, x, y, y + 1, z, w);
+
+}
+
+void map_builder_fill(MapBuilder *builder, int x, int y0, int y1, int z, int w)
+{
+
+    unsigned char *block;
+    int y;
+
+    x -= builder->dx;
+    y0 -= builder->dy;
+    y1 -= builder->dy;
+    z -= builder->dz;
+
+    if (x < 0 || x >= CHUNK_SIZE) return;
+    if (z < 0 || z >= CHUNK_SIZE) return;
+
+    y0 = MAX(y0, 0);
+    y1 = MIN(y1, Y_SIZE);
+
+    if (y0 >= y1)
+        return;
+
+    block = builder->blocks + MAP_BUILDER_INDEX(x, y0, z);
+
+    for (y = y0; y < y1; y++, block += CHUNK_SIZE * CHUNK_SIZE)
+        *block = w;
+
+    if (w && y1 > builder->height)
+        builder->height = y1;
+
+}
+
+void map_build(Map *map, MapBuilder *builder)
+{
+
+    unsigned int count = 0;
+    unsigned int mask;
+    int x, y, z;
+
+    if (map->palette)
+    {
+
+        palette_build(map->palette, builder->blocks, builder->height);
+
+        return;
 
     }
 
-    free(map->data);
-    map->mask = new_map.mask;
-    map->size = new_map.size;
-    map->data = new_map.data;
+    for (y = 0; y < builder->height; y++)
+    {
+
+        for (z = 0; z < CHUNK_SIZE; z++)
+        {
+
+            for (x = 0; x < CHUNK_SIZE; x++)
+                count += builder->blocks[MAP_BUILDER_INDEX(x, y, z)] != 0;
+
+        }
+
+    }
+
+    if (map->old)
+        pool_free(map->old, (map->old_mask + 1) * sizeof(MapEntry));
+
+    mask = MAP_MIN_MASK;
+
+    while (count * 2 > mask)
+        mask = (mask << 1) | 1;
+
+    pool_free(map->data, (map->mask + 1) * sizeof(MapEntry));
+
+    map->mask = mask;
+    map->size = 0;
+    map->data = (MapEntry *)pool_calloc((map->mask + 1) * sizeof(MapEntry));
+    map->old = 0;
+    map->old_mask = 0;
+    map->migrate = 0;
+
+    for (y = 0; y < builder->height; y++)
+    {
+
+        for (z = 0; z < CHUNK_SIZE; z++)
+        {
+
+            for (x = 0; x < CHUNK_SIZE; x++)
+            {
+
+                int w = builder->blocks[MAP_BUILDER_INDEX(x, y, z)];
+
+                if (w)
+                    map_set(map, builder->dx + x, builder->dy + y, builder->dz + z, w);
+
+            }
+
+        }
+
+    }
 
 }
 
+void map_stats(MapStats *out)
+{
+
+    out->rehash_steps = __atomic_exchange_n(&stats.rehash_steps, 0, __ATOMIC_RELAXED);
+    out->rehash_buckets = __atomic_exchange_n(&stats.rehash_buckets, 0, __ATOMIC_RELAXED);
+    out->grows = __atomic_exchange_n(&stats.grows, 0, __ATOMIC_RELAXED);
+    out->shrinks = __atomic_exchange_n(&stats.shrinks, 0, __ATOMIC_RELAXED);
+
+}
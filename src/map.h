@@ -15,11 +15,44 @@ typedef struct {
     unsigned int mask;
     unsigned int size;
     MapEntry *data;
+    MapEntry *old;
+    unsigned int old_mask;
+    unsigned int migrate;
+    Palette *palette;
 } Map;
 
+typedef struct {
+    int dx;
+    int dy;
+    int dz;
+    int height;
+    unsigned char *blocks;
+} MapBuilder;
+
+typedef struct {
+    unsigned int rehash_steps;
+    unsigned int rehash_buckets;
+    unsigned int grows;
+    unsigned int shrinks;
+} MapStats;
+
 void map_alloc(Map *map, int dx, int dy, int dz, int mask);
+void map_alloc_palette(Map *map, int dx, int dy, int dz);
 void map_free(Map *map);
 void map_copy(Map *dst, Map *src);
+void map_snapshot(Map *dst, Map *src);
 void map_grow(Map *map);
+int map_compact(Map *map);
 int map_set(Map *map, int x, int y, int z, int w);
 int map_get(Map *map, int x, int y, int z);
+int map_get_box(Map *map, int x, int y, int z, int lx, int ly, int lz, int *out, int pitch, int slice);
+int map_get_column(Map *map, int x, int y, int z, int ly, int *out);
+int map_get_neighbors(Map *map, int x, int y, int z, int *out);
+int map_uniform(Map *map, int section);
+int map_next(Map *map, unsigned int *index, int *x, int *y, int *z, int *w);
+void map_builder_alloc(MapBuilder *builder, int dx, int dy, int dz);
+void map_builder_free(MapBuilder *builder);
+void map_builder_set(MapBuilder *builder, int x, int y, int z, int w);
+void map_builder_fill(MapBuilder *builder, int x, int y0, int y1, int z, int w);
+void map_build(Map *map, MapBuilder *builder);
+void map_stats(MapStats *stats);
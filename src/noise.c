@@ -4,12 +4,21 @@
 #include "mtwist.h"
 #include "noise.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NOISE_SIMD 1
+#else
+#define NOISE_SIMD 0
+#endif
+
 #define F2 0.3660254037844386f
 #define G2 0.21132486540518713f
 #define F3 (1.0f / 3.0f)
 #define G3 (1.0f / 6.0f)
 #define ASSIGN(a, v0, v1, v2) (a)[0] = v0; (a)[1] = v1; (a)[2] = v2;
 #define DOT3(v1, v2) ((v1)[0] * (v2)[0] + (v1)[1] * (v2)[1] + (v1)[2] * (v2)[2])
+#define NOISE_LANES 8
+#define NOISE_BLOCK 256
 
 const static float GRAD3[16][3] = {
     { 1, 1, 0}, {-1, 1, 0}, { 1,-1, 0}, {-1,-1, 0}, 
@@ -18,74 +27,7 @@ const static float GRAD3[16][3] = {
     { 1, 0,-1}, {-1, 0,-1}, { 0,-1, 1}, { 0, 1, 1}
 };
 
-static unsigned char PERM[] = {
-    151, 160, 137,  91,  90,  15, 131,  13,
-    201,  95,  96,  53, 194, 233,   7, 225,
-    140,  36, 103,  30,  69, 142,   8,  99,
-     37, 240,  21,  10,  23, 190,   6, 148,
-    247, 120, 234,  75,   0,  26, 197,  62,
-     94, 252, 219, 203, 117,  35,  11,  32,
-     57, 177,  33,  88, 237, 149,  56,  87,
-    174,  20, 125, 136, 171, 168,  68, 175,
-     74, 165,  71, 134, 139,  48,  27, 166,
-     77, 146, 158, 231,  83, 111, 229, 122,
-     60, 211, 133, 230, 220, 105,  92,  41,
-     55,  46, 245,  40, 244, 102, 143,  54,
-     65,  25,  63, 161,   1, 216,  80,  73,
-    209,  76, 132, 187, 208,  89,  18, 169,
-    200, 196, 135, 130, 116, 188, 159,  86,
-    164, 100, 109, 198, 173, 186,   3,  64,
-     52, 217, 226, 250, 124, 123,   5, 202,
-     38, 147, 118, 126, 255,  82,  85, 212,
-    207, 206,  59, 227,  47,  16,  58,  17,
-    182, 189,  28,  42, 223, 183, 170, 213,
-    119, 248, 152,   2,  44, 154, 163,  70,
-    221, 153, 101, 155, 167,  43, 172,   9,
-    129,  22,  39, 253,  19,  98, 108, 110,
-     79, 113, 224, 232, 178, 185, 112, 104,
-    218, 246,  97, 228, 251,  34, 242, 193,
-    238, 210, 144,  12, 191, 179, 162, 241,
-     81,  51, 145, 235, 249,  14, 239, 107,
-     49, 192, 214,  31, 181, 199, 106, 157,
-    184,  84, 204, 176, 115, 121,  50,  45,
-    127,   4, 150, 254, 138, 236, 205,  93,
-    222, 114,  67,  29,  24,  72, 243, 141,
-    128, 195,  78,  66, 215,  61, 156, 180,
-    151, 160, 137,  91,  90,  15, 131,  13,
-    201,  95,  96,  53, 194, 233,   7, 225,
-    140,  36, 103,  30,  69, 142,   8,  99,
-     37, 240,  21,  10,  23, 190,   6, 148,
-    247, 120, 234,  75,   0,  26, 197,  62,
-     94, 252, 219, 203, 117,  35,  11,  32,
-     57, 177,  33,  88, 237, 149,  56,  87,
-    174,  20, 125, 136, 171, 168,  68, 175,
-     74, 165,  71, 134, 139,  48,  27, 166,
-     77, 146, 158, 231,  83, 111, 229, 122,
-     60, 211, 133, 230, 220, 105,  92,  41,
-     55,  46, 245,  40, 244, 102, 143,  54,
-     65,  25,  63, 161,   1, 216,  80,  73,
-    209,  76, 132, 187, 208,  89,  18, 169,
-    200, 196, 135, 130, 116, 188, 159,  86,
-    164, 100, 109, 198, 173, 186,   3,  64,
-     52, 217, 226, 250, 124, 123,   5, 202,
-     38, 147, 118, 126, 255,  82,  85, 212,
-    207, 206,  59, 227,  47,  16,  58,  17,
-    182, 189,  28,  42, 223, 183, 170, 213,
-    119, 248, 152,   2,  44, 154, 163,  70,
-    221, 153, 101, 155, 167,  43, 172,   9,
-    129,  22,  39, 253,  19,  98, 108, 110,
-     79, 113, 224, 232, 178, 185, 112, 104,
-    218, 246,  97, 228, 251,  34, 242, 193,
-    238, 210, 144,  12, 191, 179, 162, 241,
-     81,  51, 145, 235, 249,  14, 239, 107,
-     49, 192, 214,  31, 181, 199, 106, 157,
-    184,  84, 204, 176, 115, 121,  50,  45,
-    127,   4, 150, 254, 138, 236, 205,  93,
-    222, 114,  67,  29,  24,  72, 243, 141,
-    128, 195,  78,  66, 215,  61, 156, 180
-};
-
-static float noise2(float x, float y)
+static float noise2(NoiseContext *context, float x, float y)
 {
 
     int i1, j1, I, J, c;
@@ -107,9 +49,9 @@ static float noise2(float x, float y)
     yy[1] = yy[0] - j1 + G2;
     I = (int) i & 255;
     J = (int) j & 255;
-    g[0] = PERM[I + PERM[J]] % 12;
-    g[1] = PERM[I + i1 + PERM[J + j1]] % 12;
-    g[2] = PERM[I + 1 + PERM[J + 1]] % 12;
+    g[0] = context->perm[I + context->perm[J]] % 12;
+    g[1] = context->perm[I + i1 + context->perm[J + j1]] % 12;
+    g[2] = context->perm[I + 1 + context->perm[J + 1]] % 12;
 
     for (c = 0; c <= 2; c++)
         f[c] = 0.5f - xx[c]*xx[c] - yy[c]*yy[c];
@@ -126,7 +68,7 @@ static float noise2(float x, float y)
 
 }
 
-static float noise3(float x, float y, float z)
+static float noise3(NoiseContext *context, float x, float y, float z)
 {
 
     int c, o1[3], o2[3], g[4], I, J, K;
@@ -212,10 +154,10 @@ static float noise3(float x, float y, float z)
     I = (int) i & 255; 
     J = (int) j & 255; 
     K = (int) k & 255;
-    g[0] = PERM[I + PERM[J + PERM[K]]] % 12;
-    g[1] = PERM[I + o1[0] + PERM[J + o1[1] + PERM[o1[2] + K]]] % 12;
-    g[2] = PERM[I + o2[0] + PERM[J + o2[1] + PERM[o2[2] + K]]] % 12;
-    g[3] = PERM[I + 1 + PERM[J + 1 + PERM[K + 1]]] % 12; 
+    g[0] = context->perm[I + context->perm[J + context->perm[K]]] % 12;
+    g[1] = context->perm[I + o1[0] + context->perm[J + o1[1] + context->perm[o1[2] + K]]] % 12;
+    g[2] = context->perm[I + o2[0] + context->perm[J + o2[1] + context->perm[o2[2] + K]]] % 12;
+    g[3] = context->perm[I + 1 + context->perm[J + 1 + context->perm[K + 1]]] % 12; 
 
     for (c = 0; c <= 3; c++)
         f[c] = 0.6f - pos[c][0] * pos[c][0] - pos[c][1] * pos[c][1] - pos[c][2] * pos[c][2];
@@ -232,13 +174,376 @@ static float noise3(float x, float y, float z)
 
 }
 
-float noise_simplex2(float x, float y, int octaves, float persistence, float lacunarity)
+#if NOISE_SIMD
+
+static void hash2(NoiseContext *context, int lanes, const int *I, const int *J, int gt_xy, float *grad)
+{
+
+    int l;
+
+    for (l = 0; l < lanes; l++)
+    {
+
+        int a = I[l] & 255;
+        int b = J[l] & 255;
+        int o = gt_xy >> l & 1;
+        int g0 = context->perm[a + context->perm[b]] % 12;
+        int g1 = context->perm[a + o + context->perm[b + !o]] % 12;
+        int g2 = context->perm[a + 1 + context->perm[b + 1]] % 12;
+
+        grad[0 * NOISE_LANES + l] = GRAD3[g0][0];
+        grad[1 * NOISE_LANES + l] = GRAD3[g0][1];
+        grad[2 * NOISE_LANES + l] = GRAD3[g1][0];
+        grad[3 * NOISE_LANES + l] = GRAD3[g1][1];
+        grad[4 * NOISE_LANES + l] = GRAD3[g2][0];
+        grad[5 * NOISE_LANES + l] = GRAD3[g2][1];
+
+    }
+
+}
+
+static void hash3(NoiseContext *context, int lanes, const int *I, const int *J, const int *K, int ge_xy, int ge_yz, int ge_xz, float *offset, float *grad)
+{
+
+    int l, c;
+
+    for (l = 0; l < lanes; l++)
+    {
+
+        int a = I[l] & 255;
+        int b = J[l] & 255;
+        int d = K[l] & 255;
+        int o1[3], o2[3], g[4];
+
+        if (ge_xy >> l & 1)
+        {
+
+            if (ge_yz >> l & 1)
+            {
+
+                ASSIGN(o1, 1, 0, 0);
+                ASSIGN(o2, 1, 1, 0);
+
+            }
+
+            else if (ge_xz >> l & 1)
+            {
+
+                ASSIGN(o1, 1, 0, 0);
+                ASSIGN(o2, 1, 0, 1);
+
+            }
+
+            else
+            {
+
+                ASSIGN(o1, 0, 0, 1);
+                ASSIGN(o2, 1, 0, 1);
+
+            }
+
+        }
+
+        else
+        {
+
+            if (!(ge_yz >> l & 1))
+            {
+
+                ASSIGN(o1, 0, 0, 1);
+                ASSIGN(o2, 0, 1, 1);
+
+            }
+
+            else if (!(ge_xz >> l & 1))
+            {
+
+                ASSIGN(o1, 0, 1, 0);
+                ASSIGN(o2, 0, 1, 1);
+
+            }
+
+            else
+            {
+
+                ASSIGN(o1, 0, 1, 0);
+                ASSIGN(o2, 1, 1, 0);
+
+            }
+
+        }
+
+        g[0] = context->perm[a + context->perm[b + context->perm[d]]] % 12;
+        g[1] = context->perm[a + o1[0] + context->perm[b + o1[1] + context->perm[o1[2] + d]]] % 12;
+        g[2] = context->perm[a + o2[0] + context->perm[b + o2[1] + context->perm[o2[2] + d]]] % 12;
+        g[3] = context->perm[a + 1 + context->perm[b + 1 + context->perm[d + 1]]] % 12;
+
+        for (c = 0; c < 3; c++)
+        {
+
+            offset[c * NOISE_LANES + l] = o1[c];
+            offset[(c + 3) * NOISE_LANES + l] = o2[c];
+
+        }
+
+        for (c = 0; c < 12; c++)
+            grad[c * NOISE_LANES + l] = GRAD3[g[c / 3]][c % 3];
+
+    }
+
+}
+
+__attribute__((target("sse4.1")))
+static __m128 noise2_sse(NoiseContext *context, __m128 x, __m128 y)
+{
+
+    int I[NOISE_LANES], J[NOISE_LANES], c;
+    float grad[6 * NOISE_LANES];
+    __m128 xx[3], yy[3], noise[3];
+    __m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+    __m128 i = _mm_floor_ps(_mm_add_ps(x, s));
+    __m128 j = _mm_floor_ps(_mm_add_ps(y, s));
+    __m128 t = _mm_mul_ps(_mm_add_ps(i, j), _mm_set1_ps(G2));
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 m;
+
+    xx[0] = _mm_sub_ps(x, _mm_sub_ps(i, t));
+    yy[0] = _mm_sub_ps(y, _mm_sub_ps(j, t));
+    m = _mm_cmpgt_ps(xx[0], yy[0]);
+    xx[2] = _mm_sub_ps(_mm_add_ps(xx[0], _mm_set1_ps(G2 * 2.0f)), one);
+    yy[2] = _mm_sub_ps(_mm_add_ps(yy[0], _mm_set1_ps(G2 * 2.0f)), one);
+    xx[1] = _mm_add_ps(_mm_sub_ps(xx[0], _mm_and_ps(m, one)), _mm_set1_ps(G2));
+    yy[1] = _mm_add_ps(_mm_sub_ps(yy[0], _mm_andnot_ps(m, one)), _mm_set1_ps(G2));
+
+    _mm_storeu_si128((__m128i *)I, _mm_cvttps_epi32(i));
+    _mm_storeu_si128((__m128i *)J, _mm_cvttps_epi32(j));
+    hash2(context, 4, I, J, _mm_movemask_ps(m), grad);
+
+    for (c = 0; c <= 2; c++)
+    {
+
+        __m128 f = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(xx[c], xx[c])), _mm_mul_ps(yy[c], yy[c]));
+        __m128 d = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(grad + (c * 2) * NOISE_LANES), xx[c]), _mm_mul_ps(_mm_loadu_ps(grad + (c * 2 + 1) * NOISE_LANES), yy[c]));
+        __m128 n = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(f, f), f), f), d);
+
+        noise[c] = _mm_and_ps(n, _mm_cmpgt_ps(f, _mm_setzero_ps()));
+
+    }
+
+    return _mm_mul_ps(_mm_add_ps(_mm_add_ps(noise[0], noise[1]), noise[2]), _mm_set1_ps(70.0f));
+
+}
+
+__attribute__((target("sse4.1")))
+static __m128 noise3_sse(NoiseContext *context, __m128 x, __m128 y, __m128 z)
+{
+
+    int I[NOISE_LANES], J[NOISE_LANES], K[NOISE_LANES], c, a;
+    float offset[6 * NOISE_LANES], grad[12 * NOISE_LANES];
+    __m128 pos[4][3], noise[4];
+    __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(F3));
+    __m128 i = _mm_floor_ps(_mm_add_ps(x, s));
+    __m128 j = _mm_floor_ps(_mm_add_ps(y, s));
+    __m128 k = _mm_floor_ps(_mm_add_ps(z, s));
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(i, j), k), _mm_set1_ps(G3));
+
+    pos[0][0] = _mm_sub_ps(x, _mm_sub_ps(i, t));
+    pos[0][1] = _mm_sub_ps(y, _mm_sub_ps(j, t));
+    pos[0][2] = _mm_sub_ps(z, _mm_sub_ps(k, t));
+
+    _mm_storeu_si128((__m128i *)I, _mm_cvttps_epi32(i));
+    _mm_storeu_si128((__m128i *)J, _mm_cvttps_epi32(j));
+    _mm_storeu_si128((__m128i *)K, _mm_cvttps_epi32(k));
+    hash3(context, 4, I, J, K, _mm_movemask_ps(_mm_cmpge_ps(pos[0][0], pos[0][1])), _mm_movemask_ps(_mm_cmpge_ps(pos[0][1], pos[0][2])), _mm_movemask_ps(_mm_cmpge_ps(pos[0][0], pos[0][2])), offset, grad);
+
+    for (c = 0; c <= 2; c++)
+    {
+
+        pos[3][c] = _mm_add_ps(_mm_sub_ps(pos[0][c], _mm_set1_ps(1.0f)), _mm_set1_ps(3.0f * G3));
+        pos[2][c] = _mm_add_ps(_mm_sub_ps(pos[0][c], _mm_loadu_ps(offset + (c + 3) * NOISE_LANES)), _mm_set1_ps(2.0f * G3));
+        pos[1][c] = _mm_add_ps(_mm_sub_ps(pos[0][c], _mm_loadu_ps(offset + c * NOISE_LANES)), _mm_set1_ps(G3));
+
+    }
+
+    for (c = 0; c <= 3; c++)
+    {
+
+        __m128 f = _mm_set1_ps(0.6f);
+        __m128 d;
+        __m128 n;
+
+        for (a = 0; a < 3; a++)
+            f = _mm_sub_ps(f, _mm_mul_ps(pos[c][a], pos[c][a]));
+
+        d = _mm_mul_ps(pos[c][0], _mm_loadu_ps(grad + (c * 3) * NOISE_LANES));
+        d = _mm_add_ps(d, _mm_mul_ps(pos[c][1], _mm_loadu_ps(grad + (c * 3 + 1) * NOISE_LANES)));
+        d = _mm_add_ps(d, _mm_mul_ps(pos[c][2], _mm_loadu_ps(grad + (c * 3 + 2) * NOISE_LANES)));
+        n = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(f, f), f), f), d);
+
+        noise[c] = _mm_and_ps(n, _mm_cmpgt_ps(f, _mm_setzero_ps()));
+
+    }
+
+    return _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(noise[0], noise[1]), noise[2]), noise[3]), _mm_set1_ps(32.0f));
+
+}
+
+__attribute__((target("avx2")))
+static __m256 noise2_avx(NoiseContext *context, __m256 x, __m256 y)
+{
+
+    int I[NOISE_LANES], J[NOISE_LANES], c;
+    float grad[6 * NOISE_LANES];
+    __m256 xx[3], yy[3], noise[3];
+    __m256 s = _mm256_mul_ps(_mm256_add_ps(x, y), _mm256_set1_ps(F2));
+    __m256 i = _mm256_floor_ps(_mm256_add_ps(x, s));
+    __m256 j = _mm256_floor_ps(_mm256_add_ps(y, s));
+    __m256 t = _mm256_mul_ps(_mm256_add_ps(i, j), _mm256_set1_ps(G2));
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 m;
+
+    xx[0] = _mm256_sub_ps(x, _mm256_sub_ps(i, t));
+    yy[0] = _mm256_sub_ps(y, _mm256_sub_ps(j, t));
+    m = _mm256_cmp_ps(xx[0], yy[0], _CMP_GT_OQ);
+    xx[2] = _mm256_sub_ps(_mm256_add_ps(xx[0], _mm256_set1_ps(G2 * 2.0f)), one);
+    yy[2] = _mm256_sub_ps(_mm256_add_ps(yy[0], _mm256_set1_ps(G2 * 2.0f)), one);
+    xx[1] = _mm256_add_ps(_mm256_sub_ps(xx[0], _mm256_and_ps(m, one)), _mm256_set1_ps(G2));
+    yy[1] = _mm256_add_ps(_mm256_sub_ps(yy[0], _mm256_andnot_ps(m, one)), _mm256_set1_ps(G2));
+
+    _mm256_storeu_si256((__m256i *)I, _mm256_cvttps_epi32(i));
+    _mm256_storeu_si256((__m256i *)J, _mm256_cvttps_epi32(j));
+    hash2(context, 8, I, J, _mm256_movemask_ps(m), grad);
+
+    for (c = 0; c <= 2; c++)
+    {
+
+        __m256 f = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(xx[c], xx[c])), _mm256_mul_ps(yy[c], yy[c]));
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(grad + (c * 2) * NOISE_LANES), xx[c]), _mm256_mul_ps(_mm256_loadu_ps(grad + (c * 2 + 1) * NOISE_LANES), yy[c]));
+        __m256 n = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(f, f), f), f), d);
+
+        noise[c] = _mm256_and_ps(n, _mm256_cmp_ps(f, _mm256_setzero_ps(), _CMP_GT_OQ));
+
+    }
+
+    return _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(noise[0], noise[1]), noise[2]), _mm256_set1_ps(70.0f));
+
+}
+
+__attribute__((target("avx2")))
+static __m256 noise3_avx(NoiseContext *context, __m256 x, __m256 y, __m256 z)
+{
+
+    int I[NOISE_LANES], J[NOISE_LANES], K[NOISE_LANES], c, a;
+    float offset[6 * NOISE_LANES], grad[12 * NOISE_LANES];
+    __m256 pos[4][3], noise[4];
+    __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), _mm256_set1_ps(F3));
+    __m256 i = _mm256_floor_ps(_mm256_add_ps(x, s));
+    __m256 j = _mm256_floor_ps(_mm256_add_ps(y, s));
+    __m256 k = _mm256_floor_ps(_mm256_add_ps(z, s));
+    __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(i, j), k), _mm256_set1_ps(G3));
+
+    pos[0][0] = _mm256_sub_ps(x, _mm256_sub_ps(i, t));
+    pos[0][1] = _mm256_sub_ps(y, _mm256_sub_ps(j, t));
+    pos[0][2] = _mm256_sub_ps(z, _mm256_sub_ps(k, t));
+
+    _mm256_storeu_si256((__m256i *)I, _mm256_cvttps_epi32(i));
+    _mm256_storeu_si256((__m256i *)J, _mm256_cvttps_epi32(j));
+    _mm256_storeu_si256((__m256i *)K, _mm256_cvttps_epi32(k));
+    hash3(context, 8, I, J, K, _mm256_movemask_ps(_mm256_cmp_ps(pos[0][0], pos[0][1], _CMP_GE_OQ)), _mm256_movemask_ps(_mm256_cmp_ps(pos[0][1], pos[0][2], _CMP_GE_OQ)), _mm256_movemask_ps(_mm256_cmp_ps(pos[0][0], pos[0][2], _CMP_GE_OQ)), offset, grad);
+
+    for (c = 0; c <= 2; c++)
+    {
+
+        pos[3][c] = _mm256_add_ps(_mm256_sub_ps(pos[0][c], _mm256_set1_ps(1.0f)), _mm256_set1_ps(3.0f * G3));
+        pos[2][c] = _mm256_add_ps(_mm256_sub_ps(pos[0][c], _mm256_loadu_ps(offset + (c + 3) * NOISE_LANES)), _mm256_set1_ps(2.0f * G3));
+        pos[1][c] = _mm256_add_ps(_mm256_sub_ps(pos[0][c], _mm256_loadu_ps(offset + c * NOISE_LANES)), _mm256_set1_ps(G3));
+
+    }
+
+    for (c = 0; c <= 3; c++)
+    {
+
+        __m256 f = _mm256_set1_ps(0.6f);
+        __m256 d;
+        __m256 n;
+
+        for (a = 0; a < 3; a++)
+            f = _mm256_sub_ps(f, _mm256_mul_ps(pos[c][a], pos[c][a]));
+
+        d = _mm256_mul_ps(pos[c][0], _mm256_loadu_ps(grad + (c * 3) * NOISE_LANES));
+        d = _mm256_add_ps(d, _mm256_mul_ps(pos[c][1], _mm256_loadu_ps(grad + (c * 3 + 1) * NOISE_LANES)));
+        d = _mm256_add_ps(d, _mm256_mul_ps(pos[c][2], _mm256_loadu_ps(grad + (c * 3 + 2) * NOISE_LANES)));
+        n = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(f, f), f), f), d);
+
+        noise[c] = _mm256_and_ps(n, _mm256_cmp_ps(f, _mm256_setzero_ps(), _CMP_GT_OQ));
+
+    }
+
+    return _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(noise[0], noise[1]), noise[2]), noise[3]), _mm256_set1_ps(32.0f));
+
+}
+
+__attribute__((target("sse4.1")))
+static int batch2_sse(NoiseContext *context, float *out, const float *x, const float *y, int count)
+{
+
+    int n;
+
+    for (n = 0; n + 4 <= count; n += 4)
+        _mm_storeu_ps(out + n, noise2_sse(context, _mm_loadu_ps(x + n), _mm_loadu_ps(y + n)));
+
+    return n;
+
+}
+
+__attribute__((target("sse4.1")))
+static int batch3_sse(NoiseContext *context, float *out, const float *x, const float *y, const float *z, int count)
+{
+
+    int n;
+
+    for (n = 0; n + 4 <= count; n += 4)
+        _mm_storeu_ps(out + n, noise3_sse(context, _mm_loadu_ps(x + n), _mm_loadu_ps(y + n), _mm_loadu_ps(z + n)));
+
+    return n;
+
+}
+
+__attribute__((target("avx2")))
+static int batch2_avx(NoiseContext *context, float *out, const float *x, const float *y, int count)
+{
+
+    int n;
+
+    for (n = 0; n + 8 <= count; n += 8)
+        _mm256_storeu_ps(out + n, noise2_avx(context, _mm256_loadu_ps(x + n), _mm256_loadu_ps(y + n)));
+
+    return n;
+
+}
+
+__attribute__((target("avx2")))
+static int batch3_avx(NoiseContext *context, float *out, const float *x, const float *y, const float *z, int count)
+{
+
+    int n;
+
+    for (n = 0; n + 8 <= count; n += 8)
+        _mm256_storeu_ps(out + n, noise3_avx(context, _mm256_loadu_ps(x + n), _mm256_loadu_ps(y + n), _mm256_loadu_ps(z + n)));
+
+    return n;
+
+}
+
+#endif
+
+float noise_simplex2(NoiseContext *context, float x, float y, int octaves, float persistence, float lacunarity)
 {
 
     float freq = 1.0f;
     float amp = 1.0f;
     float max = 1.0f;
-    float total = noise2(x, y);
+    float total = noise2(context, x, y);
     int i;
 
     for (i = 1; i < octaves; i++)
@@ -247,7 +552,7 @@ float noise_simplex2(float x, float y, int octaves, float persistence, float lac
         freq *= lacunarity;
         amp *= persistence;
         max += amp;
-        total += noise2(x * freq, y * freq) * amp;
+        total += noise2(context, x * freq, y * freq) * amp;
 
     }
 
@@ -255,13 +560,13 @@ float noise_simplex2(float x, float y, int octaves, float persistence, float lac
     
 }
 
-float noise_simplex3(float x, float y, float z, int octaves, float persistence, float lacunarity)
+float noise_simplex3(NoiseContext *context, float x, float y, float z, int octaves, float persistence, float lacunarity)
 {
 
     float freq = 1.0f;
     float amp = 1.0f;
     float max = 1.0f;
-    float total = noise3(x, y, z);
+    float total = noise3(context, x, y, z);
     int i;
 
     for (i = 1; i < octaves; ++i)
@@ -270,7 +575,7 @@ float noise_simplex3(float x, float y, float z, int octaves, float persistence,
         freq *= lacunarity;
         amp *= persistence;
         max += amp;
-        total += noise3(x * freq, y * freq, z * freq) * amp;
+        total += noise3(context, x * freq, y * freq, z * freq) * amp;
 
     }
 
@@ -278,25 +583,202 @@ float noise_simplex3(float x, float y, float z, int octaves, float persistence,
 
 }
 
-void noise_seed(struct mtwist_state *state)
+static void noise2_batch(NoiseContext *context, float *out, const float *x, const float *y, int count)
+{
+
+    int n = 0;
+
+#if NOISE_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        n += batch2_avx(context, out, x, y, count);
+
+    if (__builtin_cpu_supports("sse4.1"))
+        n += batch2_sse(context, out + n, x + n, y + n, count - n);
+#endif
+
+    for (; n < count; n++)
+        out[n] = noise2(context, x[n], y[n]);
+
+}
+
+static void noise3_batch(NoiseContext *context, float *out, const float *x, const float *y, const float *z, int count)
+{
+
+    int n = 0;
+
+#if NOISE_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        n += batch3_avx(context, out, x, y, z, count);
+
+    if (__builtin_cpu_supports("sse4.1"))
+        n += batch3_sse(context, out + n, x + n, y + n, z + n, count - n);
+#endif
+
+    for (; n < count; n++)
+        out[n] = noise3(context, x[n], y[n], z[n]);
+
+}
+
+void noise_simplex2_grid(NoiseContext *context, float *out, int x, int y, int nx, int ny, double sx, double sy, int octaves, float persistence, float lacunarity)
+{
+
+    float px[NOISE_BLOCK], py[NOISE_BLOCK];
+    float fx[NOISE_BLOCK], fy[NOISE_BLOCK];
+    float noise[NOISE_BLOCK];
+    int count = nx * ny;
+    int start;
+
+    for (start = 0; start < count; start += NOISE_BLOCK)
+    {
+
+        int length = count - start < NOISE_BLOCK ? count - start : NOISE_BLOCK;
+        float *total = out + start;
+        float freq = 1.0f;
+        float amp = 1.0f;
+        float max = 1.0f;
+        int i, o;
+
+        for (i = 0; i < length; i++)
+        {
+
+            px[i] = (x + (start + i) % nx) * sx;
+            py[i] = (y + (start + i) / nx) * sy;
+
+        }
+
+        noise2_batch(context, total, px, py, length);
+
+        for (o = 1; o < octaves; o++)
+        {
+
+            freq *= lacunarity;
+            amp *= persistence;
+            max += amp;
+
+            for (i = 0; i < length; i++)
+            {
+
+                fx[i] = px[i] * freq;
+                fy[i] = py[i] * freq;
+
+            }
+
+            noise2_batch(context, noise, fx, fy, length);
+
+            for (i = 0; i < length; i++)
+                total[i] += noise[i] * amp;
+
+        }
+
+        for (i = 0; i < length; i++)
+            total[i] = (1 + total[i] / max) / 2;
+
+    }
+
+}
+
+void noise_simplex3_grid(NoiseContext *context, float *out, int x, int y, int z, int nx, int ny, int nz, double sx, double sy, double sz, int octaves, float persistence, float lacunarity)
+{
+
+    float px[NOISE_BLOCK], py[NOISE_BLOCK], pz[NOISE_BLOCK];
+    float fx[NOISE_BLOCK], fy[NOISE_BLOCK], fz[NOISE_BLOCK];
+    float noise[NOISE_BLOCK];
+    int count = nx * ny * nz;
+    int start;
+
+    for (start = 0; start < count; start += NOISE_BLOCK)
+    {
+
+        int length = count - start < NOISE_BLOCK ? count - start : NOISE_BLOCK;
+        float *total = out + start;
+        float freq = 1.0f;
+        float amp = 1.0f;
+        float max = 1.0f;
+        int i, o;
+
+        for (i = 0; i < length; i++)
+        {
+
+            int index = start + i;
+
+            px[i] = (x + index % nx) * sx;
+            py[i] = (y + index / (nx * nz)) * sy;
+            pz[i] = (z + (index / nx) % nz) * sz;
+
+        }
+
+        noise3_batch(context, total, px, py, pz, length);
+
+        for (o = 1; o < octaves; o++)
+        {
+
+            freq *= lacunarity;
+            amp *= persistence;
+            max += amp;
+
+            for (i = 0; i < length; i++)
+            {
+
+                fx[i] = px[i] * freq;
+                fy[i] = py[i] * freq;
+                fz[i] = pz[i] * freq;
+
+            }
+
+            noise3_batch(context, noise, fx, fy, fz, length);
+
+            for (i = 0; i < length; i++)
+                total[i] += noise[i] * amp;
+
+        }
+
+        for (i = 0; i < length; i++)
+            total[i] = (1 + total[i] / max) / 2;
+
+    }
+
+}
+
+unsigned int noise_chunk_seed(NoiseContext *context, int p, int q)
 {
 
+    unsigned int h = context->seed ^ ((unsigned int)p * 0x9e3779b1u) ^ ((unsigned int)q * 0x85ebca77u);
+
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+
+    return h;
+
+}
+
+void noise_seed(NoiseContext *context, unsigned int seed)
+{
+
+    struct mtwist_state state;
+
+    context->seed = seed;
+
+    mtwist_seed1(&state, seed);
+
     for (int i = 0; i < 256; i++)
-        PERM[i] = i;
+        context->perm[i] = i;
 
     for (int i = 255; i > 0; i--)
     {
 
-        int j = mtwist_rand(state) % (i + 1);
-        unsigned char a = PERM[i];
-        unsigned char b = PERM[j];
+        int j = mtwist_rand(&state) % (i + 1);
+        unsigned char a = context->perm[i];
+        unsigned char b = context->perm[j];
 
-        PERM[i] = b;
-        PERM[j] = a;
+        context->perm[i] = b;
+        context->perm[j] = a;
 
     }
 
-    memcpy(PERM + 256, PERM, sizeof(unsigned char) * 256);
+    memcpy(context->perm + 256, context->perm, sizeof(unsigned char) * 256);
 
 }
 
@@ -1,3 +1,11 @@
-float noise_simplex2(float x, float y, int octaves, float persistence, float lacunarity);
-float noise_simplex3(float x, float y, float z, int octaves, float persistence, float lacunarity);
-void noise_seed(struct mtwist_state *state);
+typedef struct {
+    unsigned int seed;
+    unsigned char perm[512];
+} NoiseContext;
+
+float noise_simplex2(NoiseContext *context, float x, float y, int octaves, float persistence, float lacunarity);
+float noise_simplex3(NoiseContext *context, float x, float y, float z, int octaves, float persistence, float lacunarity);
+void noise_simplex2_grid(NoiseContext *context, float *out, int x, int y, int nx, int ny, double sx, double sy, int octaves, float persistence, float lacunarity);
+void noise_simplex3_grid(NoiseContext *context, float *out, int x, int y, int z, int nx, int ny, int nz, double sx, double sy, double sz, int octaves, float persistence, float lacunarity);
+unsigned int noise_chunk_seed(NoiseContext *context, int p, int q);
+void noise_seed(NoiseContext *context, unsigned int seed);
@@ -0,0 +1,590 @@
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "pool.h"
+#include "palette.h"
+
+#define SECTION_VOLUME                  (CHUNK_SIZE * SECTION_SIZE * CHUNK_SIZE)
+#define PALETTE_VOLUME                  (CHUNK_SIZE * Y_SIZE * CHUNK_SIZE)
+#define PALETTE_INDEX(x, y, z)          ((((y) & (SECTION_SIZE - 1)) * CHUNK_SIZE + (z)) * CHUNK_SIZE + (x))
+
+static unsigned int datasize(unsigned int bits)
+{
+
+    return SECTION_VOLUME * bits / 8;
+
+}
+
+static unsigned int readindex(Section *section, unsigned int i)
+{
+
+    unsigned int byte = i >> (3 - section->shift);
+    unsigned int offset = (i & ((8 >> section->shift) - 1)) << section->shift;
+
+    return (section->data[byte] >> offset) & ((1 << section->bits) - 1);
+
+}
+
+static void writeindex(Section *section, unsigned int i, unsigned int value)
+{
+
+    unsigned int byte = i >> (3 - section->shift);
+    unsigned int offset = (i & ((8 >> section->shift) - 1)) << section->shift;
+    unsigned int mask = ((1 << section->bits) - 1) << offset;
+
+    section->data[byte] = (section->data[byte] & ~mask) | (value << offset);
+
+}
+
+static void repack(Section *section, unsigned int shift)
+{
+
+    Section new_section;
+    unsigned int i;
+
+    new_section.bits = 1 << shift;
+    new_section.shift = shift;
+    new_section.data = (unsigned char *)pool_calloc(datasize(new_section.bits));
+
+    for (i = 0; i < SECTION_VOLUME; i++)
+        writeindex(&new_section, i, readindex(section, i));
+
+    pool_free(section->data, datasize(section->bits));
+    section->bits = new_section.bits;
+    section->shift = new_section.shift;
+    section->data = new_section.data;
+
+}
+
+static void expand(Section *section)
+{
+
+    section->bits = 1;
+    section->shift = 0;
+    section->count = 1;
+    section->entries = (unsigned char *)pool_alloc(sizeof(unsigned char) * 256);
+    section->counts = (unsigned short *)pool_alloc(sizeof(unsigned short) * 256);
+    section->data = (unsigned char *)pool_calloc(datasize(section->bits));
+    section->refs = (unsigned int *)pool_alloc(sizeof(unsigned int));
+    section->entries[0] = section->uniform;
+    section->counts[0] = SECTION_VOLUME;
+    *section->refs = 1;
+
+}
+
+static void release(Section *section)
+{
+
+    if (!section->bits)
+        return;
+
+    if (__atomic_sub_fetch(section->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    pool_free(section->entries, sizeof(unsigned char) * 256);
+    pool_free(section->counts, sizeof(unsigned short) * 256);
+    pool_free(section->data, datasize(section->bits));
+    pool_free(section->refs, sizeof(unsigned int));
+
+}
+
+static void duplicate(Section *dst, Section *src)
+{
+
+    dst->entries = (unsigned char *)pool_alloc(sizeof(unsigned char) * 256);
+    dst->counts = (unsigned short *)pool_alloc(sizeof(unsigned short) * 256);
+    dst->data = (unsigned char *)pool_alloc(datasize(src->bits));
+    dst->refs = (unsigned int *)pool_alloc(sizeof(unsigned int));
+
+    memcpy(dst->entries, src->entries, sizeof(unsigned char) * 256);
+    memcpy(dst->counts, src->counts, sizeof(unsigned short) * 256);
+    memcpy(dst->data, src->data, datasize(src->bits));
+
+    *dst->refs = 1;
+
+}
+
+static void own(Section *section)
+{
+
+    Section shared;
+
+    if (__atomic_load_n(section->refs, __ATOMIC_ACQUIRE) == 1)
+        return;
+
+    memcpy(&shared, section, sizeof(Section));
+    duplicate(section, &shared);
+    release(&shared);
+
+}
+
+static void collapse(Section *section, int w)
+{
+
+    release(section);
+
+    section->bits = 0;
+    section->shift = 0;
+    section->count = 1;
+    section->uniform = w;
+    section->entries = 0;
+    section->counts = 0;
+    section->data = 0;
+    section->refs = 0;
+
+}
+
+static unsigned int lookup(Section *section, int w)
+{
+
+    unsigned int i;
+
+    for (i = 0; i < section->count; i++)
+    {
+
+        if (section->entries[i] == w)
+            return i;
+
+    }
+
+    for (i = 0; i < section->count; i++)
+    {
+
+        if (section->counts[i] == 0)
+        {
+
+            section->entries[i] = w;
+
+            return i;
+
+        }
+
+    }
+
+    if (section->count == (1u << section->bits))
+        repack(section, section->shift + 1);
+
+    section->entries[section->count] = w;
+    section->counts[section->count] = 0;
+
+    return section->count++;
+
+}
+
+static int compact(Section *section)
+{
+
+    Section new_section;
+    unsigned char remap[256];
+    unsigned int live = 0;
+    unsigned int shift = 0;
+    unsigned int i;
+
+    if (!section->bits)
+        return 0;
+
+    for (i = 0; i < section->count; i++)
+    {
+
+        if (section->counts[i])
+            live++;
+
+    }
+
+    if (live == 1)
+    {
+
+        for (i = 0; !section->counts[i]; i++);
+
+        collapse(section, section->entries[i]);
+
+        return 1;
+
+    }
+
+    while ((1u << (1 << shift)) < live)
+        shift++;
+
+    if (shift >= section->shift)
+        return 0;
+
+    own(section);
+
+    new_section.bits = 1 << shift;
+    new_section.shift = shift;
+    new_section.count = 0;
+    new_section.entries = section->entries;
+    new_section.counts = section->counts;
+    new_section.refs = section->refs;
+    new_section.data = (unsigned char *)pool_calloc(datasize(new_section.bits));
+
+    for (i = 0; i < section->count; i++)
+    {
+
+        if (!section->counts[i])
+            continue;
+
+        remap[i] = new_section.count;
+        new_section.entries[new_section.count] = section->entries[i];
+        new_section.counts[new_section.count] = section->counts[i];
+        new_section.count++;
+
+    }
+
+    for (i = 0; i < SECTION_VOLUME; i++)
+        writeindex(&new_section, i, remap[readindex(section, i)]);
+
+    pool_free(section->data, datasize(section->bits));
+    memcpy(section, &new_section, sizeof(Section));
+
+    return 1;
+
+}
+
+static void build(Section *section, unsigned char *blocks)
+{
+
+    unsigned int histogram[256];
+    unsigned char remap[256];
+    unsigned int live = 0;
+    unsigned int shift = 0;
+    unsigned int i;
+
+    memset(histogram, 0, sizeof(histogram));
+
+    for (i = 0; i < SECTION_VOLUME; i++)
+        histogram[blocks[i]]++;
+
+    for (i = 0; i < 256; i++)
+    {
+
+        if (histogram[i])
+            live++;
+
+    }
+
+    if (live == 1)
+    {
+
+        section->uniform = blocks[0];
+
+        return;
+
+    }
+
+    while ((1u << (1 << shift)) < live)
+        shift++;
+
+    section->bits = 1 << shift;
+    section->shift = shift;
+    section->count = 0;
+    section->entries = (unsigned char *)pool_alloc(sizeof(unsigned char) * 256);
+    section->counts = (unsigned short *)pool_alloc(sizeof(unsigned short) * 256);
+    section->data = (unsigned char *)pool_calloc(datasize(section->bits));
+    section->refs = (unsigned int *)pool_alloc(sizeof(unsigned int));
+    *section->refs = 1;
+
+    for (i = 0; i < 256; i++)
+    {
+
+        if (!histogram[i])
+            continue;
+
+        remap[i] = section->count;
+        section->entries[section->count] = i;
+        section->counts[section->count] = histogram[i];
+        section->count++;
+
+    }
+
+    for (i = 0; i < SECTION_VOLUME; i++)
+    {
+
+        if (remap[blocks[i]])
+            writeindex(section, i, remap[blocks[i]]);
+
+    }
+
+}
+
+void palette_alloc(Palette *palette)
+{
+
+    unsigned int i;
+
+    for (i = 0; i < SECTION_COUNT; i++)
+    {
+
+        Section *section = palette->sections + i;
+
+        section->bits = 0;
+        section->shift = 0;
+        section->count = 1;
+        section->uniform = 0;
+        section->entries = 0;
+        section->counts = 0;
+        section->data = 0;
+        section->refs = 0;
+
+    }
+
+}
+
+void palette_free(Palette *palette)
+{
+
+    unsigned int i;
+
+    for (i = 0; i < SECTION_COUNT; i++)
+        release(palette->sections + i);
+
+}
+
+void palette_copy(Palette *dst, Palette *src)
+{
+
+    unsigned int i;
+
+    memcpy(dst, src, sizeof(Palette));
+
+    for (i = 0; i < SECTION_COUNT; i++)
+    {
+
+        Section *section = dst->sections + i;
+
+        if (!section->bits)
+            continue;
+
+        duplicate(section, src->sections + i);
+
+    }
+
+}
+
+void palette_snapshot(Palette *dst, Palette *src)
+{
+
+    unsigned int i;
+
+    memcpy(dst, src, sizeof(Palette));
+
+    for (i = 0; i < SECTION_COUNT; i++)
+    {
+
+        Section *section = dst->sections + i;
+
+        if (section->bits)
+            __atomic_add_fetch(section->refs, 1, __ATOMIC_ACQ_REL);
+
+    }
+
+}
+
+void palette_build(Palette *palette, unsigned char *blocks, int height)
+{
+
+    unsigned int i;
+
+    palette_free(palette);
+    palette_alloc(palette);
+
+    for (i = 0; i < SECTION_COUNT && i * SECTION_SIZE < height; i++)
+        build(palette->sections + i, blocks + i * SECTION_VOLUME);
+
+}
+
+int palette_set(Palette *palette, int x, int y, int z, int w)
+{
+
+    Section *section;
+    unsigned int i;
+    unsigned int old;
+    unsigned int value;
+
+    if (x < 0 || x >= CHUNK_SIZE) return 0;
+    if (y < 0 || y >= Y_SIZE) return 0;
+    if (z < 0 || z >= CHUNK_SIZE) return 0;
+
+    section = palette->sections + y / SECTION_SIZE;
+
+    if (!section->bits)
+    {
+
+        if (section->uniform == w)
+            return 0;
+
+        expand(section);
+
+    }
+
+    i = PALETTE_INDEX(x, y, z);
+    old = readindex(section, i);
+
+    if (section->entries[old] == w)
+        return 0;
+
+    own(section);
+
+    section->counts[old]--;
+
+    value = lookup(section, w);
+
+    writeindex(section, i, value);
+
+    if (++section->counts[value] == SECTION_VOLUME)
+        collapse(section, w);
+
+    return 1;
+
+}
+
+int palette_get(Palette *palette, int x, int y, int z)
+{
+
+    Section *section;
+
+    if (x < 0 || x >= CHUNK_SIZE) return 0;
+    if (y < 0 || y >= Y_SIZE) return 0;
+    if (z < 0 || z >= CHUNK_SIZE) return 0;
+
+    section = palette->sections + y / SECTION_SIZE;
+
+    if (!section->bits)
+        return section->uniform;
+
+    return section->entries[readindex(section, PALETTE_INDEX(x, y, z))];
+
+}
+
+int palette_get_box(Palette *palette, int x, int y, int z, int lx, int ly, int lz, int *out, int pitch, int slice)
+{
+
+    int count = 0;
+    int dx, dy, dz;
+
+    for (dy = 0; dy < ly; dy++)
+    {
+
+        int py = y + dy;
+        Section *section = (py >= 0 && py < Y_SIZE) ? palette->sections + py / SECTION_SIZE : 0;
+
+        for (dz = 0; dz < lz; dz++)
+        {
+
+            int pz = z + dz;
+            int *row = out + dy * slice + dz * pitch;
+
+            for (dx = 0; dx < lx; dx++)
+            {
+
+                int px = x + dx;
+                int w = 0;
+
+                if (section && px >= 0 && px < CHUNK_SIZE && pz >= 0 && pz < CHUNK_SIZE)
+                    w = section->bits ? section->entries[readindex(section, PALETTE_INDEX(px, py, pz))] : section->uniform;
+
+                row[dx] = w;
+                count += w != 0;
+
+            }
+
+        }
+
+    }
+
+    return count;
+
+}
+
+int palette_uniform(Palette *palette, int section)
+{
+
+    if (section < 0 || section >= SECTION_COUNT)
+        return -1;
+
+    if (palette->sections[section].bits)
+        return -1;
+
+    return palette->sections[section].uniform;
+
+}
+
+int palette_compact(Palette *palette)
+{
+
+    int result = 0;
+    unsigned int i;
+
+    for (i = 0; i < SECTION_COUNT; i++)
+        result |= compact(palette->sections + i);
+
+    return result;
+
+}
+
+int palette_next(Palette *palette, unsigned int *index, int *x, int *y, int *z, int *w)
+{
+
+    unsigned int i = *index;
+
+    while (i < PALETTE_VOLUME)
+    {
+
+        Section *section = palette->sections + i / SECTION_VOLUME;
+        unsigned int j = i % SECTION_VOLUME;
+        unsigned int value;
+
+        if (!section->bits)
+        {
+
+            if (!section->uniform)
+            {
+
+                i += SECTION_VOLUME - j;
+
+                continue;
+
+            }
+
+            value = section->uniform;
+
+        }
+
+        else
+        {
+
+            if ((j & ((8 >> section->shift) - 1)) == 0 && section->entries[0] == 0 && section->data[j >> (3 - section->shift)] == 0)
+            {
+
+                i += 8 >> section->shift;
+
+                continue;
+
+            }
+
+            value = section->entries[readindex(section, j)];
+
+        }
+
+        if (value)
+        {
+
+            *x = i % CHUNK_SIZE;
+            *y = i / (CHUNK_SIZE * CHUNK_SIZE);
+            *z = (i / CHUNK_SIZE) % CHUNK_SIZE;
+            *w = value;
+            *index = i + 1;
+
+            return 1;
+
+        }
+
+        i++;
+
+    }
+
+    *index = i;
+
+    return 0;
+
+}
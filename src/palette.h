@@ -0,0 +1,26 @@
+typedef struct {
+    unsigned int bits;
+    unsigned int shift;
+    unsigned int count;
+    unsigned int uniform;
+    unsigned char *entries;
+    unsigned short *counts;
+    unsigned char *data;
+    unsigned int *refs;
+} Section;
+
+typedef struct {
+    Section sections[SECTION_COUNT];
+} Palette;
+
+void palette_alloc(Palette *palette);
+void palette_free(Palette *palette);
+void palette_copy(Palette *dst, Palette *src);
+void palette_snapshot(Palette *dst, Palette *src);
+void palette_build(Palette *palette, unsigned char *blocks, int height);
+int palette_set(Palette *palette, int x, int y, int z, int w);
+int palette_get(Palette *palette, int x, int y, int z);
+int palette_get_box(Palette *palette, int x, int y, int z, int lx, int ly, int lz, int *out, int pitch, int slice);
+int palette_uniform(Palette *palette, int section);
+int palette_compact(Palette *palette);
+int palette_next(Palette *palette, unsigned int *index, int *x, int *y, int *z, int *w);
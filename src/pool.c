@@ -0,0 +1,202 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "pool.h"
+
+#if POOL_HUGEPAGES
+#include <sys/mman.h>
+#endif
+
+#define POOL_MIN_SHIFT                  6
+#define POOL_CLASSES                    32
+#define POOL_HUGEPAGE_SIZE              (2 * 1024 * 1024)
+
+typedef struct slab {
+    struct slab *next;
+} Slab;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    Slab *slabs;
+} PoolClass;
+
+static PoolClass classes[POOL_CLASSES] = {
+    [0 ... POOL_CLASSES - 1] = {PTHREAD_MUTEX_INITIALIZER, 0}
+};
+static unsigned int retained;
+static PoolStats stats;
+
+static unsigned int classof(unsigned int size)
+{
+
+    unsigned int shift = POOL_MIN_SHIFT;
+
+    while ((1u << shift) < size)
+        shift++;
+
+    return shift;
+
+}
+
+static void *sysalloc(unsigned int size)
+{
+
+#if POOL_HUGEPAGES
+    if (size >= POOL_HUGEPAGE_SIZE)
+    {
+
+        void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (ptr == MAP_FAILED)
+            return 0;
+
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+        return ptr;
+
+    }
+#endif
+
+    return malloc(size);
+
+}
+
+static void sysfree(void *ptr, unsigned int size)
+{
+
+#if POOL_HUGEPAGES
+    if (size >= POOL_HUGEPAGE_SIZE)
+    {
+
+        munmap(ptr, size);
+
+        return;
+
+    }
+#endif
+
+    free(ptr);
+
+}
+
+void *pool_alloc(unsigned int size)
+{
+
+    unsigned int shift = classof(size);
+    PoolClass *class = classes + shift;
+    Slab *slab;
+
+    __atomic_fetch_add(&stats.allocs, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&class->mutex);
+
+    slab = class->slabs;
+
+    if (slab)
+        class->slabs = slab->next;
+
+    pthread_mutex_unlock(&class->mutex);
+
+    if (slab)
+    {
+
+        __atomic_fetch_sub(&retained, 1u << shift, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.hits, 1, __ATOMIC_RELAXED);
+
+        return slab;
+
+    }
+
+    __atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+
+    return sysalloc(1u << shift);
+
+}
+
+void *pool_calloc(unsigned int size)
+{
+
+    void *ptr = pool_alloc(size);
+
+    if (ptr)
+        memset(ptr, 0, size);
+
+    return ptr;
+
+}
+
+void pool_free(void *ptr, unsigned int size)
+{
+
+    unsigned int shift = classof(size);
+    PoolClass *class = classes + shift;
+    Slab *slab = ptr;
+
+    if (!ptr)
+        return;
+
+    __atomic_fetch_add(&stats.frees, 1, __ATOMIC_RELAXED);
+
+    if (__atomic_add_fetch(&retained, 1u << shift, __ATOMIC_RELAXED) > POOL_RETAIN)
+    {
+
+        __atomic_fetch_sub(&retained, 1u << shift, __ATOMIC_RELAXED);
+        sysfree(ptr, 1u << shift);
+
+        return;
+
+    }
+
+    pthread_mutex_lock(&class->mutex);
+
+    slab->next = class->slabs;
+    class->slabs = slab;
+
+    pthread_mutex_unlock(&class->mutex);
+
+}
+
+void pool_trim(void)
+{
+
+    unsigned int i;
+
+    for (i = 0; i < POOL_CLASSES; i++)
+    {
+
+        PoolClass *class = classes + i;
+
+        pthread_mutex_lock(&class->mutex);
+
+        while (class->slabs)
+        {
+
+            Slab *slab = class->slabs;
+
+            class->slabs = slab->next;
+
+            __atomic_fetch_sub(&retained, 1u << i, __ATOMIC_RELAXED);
+            sysfree(slab, 1u << i);
+
+        }
+
+        pthread_mutex_unlock(&class->mutex);
+
+    }
+
+}
+
+void pool_stats(PoolStats *out)
+{
+
+    out->allocs = __atomic_exchange_n(&stats.allocs, 0, __ATOMIC_RELAXED);
+    out->frees = __atomic_exchange_n(&stats.frees, 0, __ATOMIC_RELAXED);
+    out->hits = __atomic_exchange_n(&stats.hits, 0, __ATOMIC_RELAXED);
+    out->misses = __atomic_exchange_n(&stats.misses, 0, __ATOMIC_RELAXED);
+    out->retained = __atomic_load_n(&retained, __ATOMIC_RELAXED);
+
+}
@@ -0,0 +1,13 @@
+typedef struct {
+    unsigned int allocs;
+    unsigned int frees;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int retained;
+} PoolStats;
+
+void *pool_alloc(unsigned int size);
+void *pool_calloc(unsigned int size);
+void pool_free(void *ptr, unsigned int size);
+void pool_trim(void);
+void pool_stats(PoolStats *stats);
@@ -0,0 +1,671 @@
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "item.h"
+#include "palette.h"
+#include "map.h"
+#include "noise.h"
+#include "world.h"
+
+#define WORLD_TREE_CHANCE               2
+#define WORLD_PENDING_MIN               64
+
+typedef struct {
+    Map *map;
+    MapBuilder builder;
+    short *heights;
+    NoiseContext *noise;
+    int p;
+    int q;
+    int grass;
+    unsigned int version;
+    short ground[CHUNK_SIZE * CHUNK_SIZE];
+} WorldChunk;
+
+typedef struct {
+    const char *name;
+    int (*run)(WorldChunk *chunk);
+} WorldStage;
+
+typedef struct {
+    int p;
+    int q;
+    unsigned int count;
+    unsigned int capacity;
+    MapEntry *edits;
+} WorldPending;
+
+static WorldStats stats;
+static WorldPending *pending;
+static unsigned int pending_mask;
+static unsigned int pending_size;
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int chunked(int x)
+{
+
+    return x < 0 ? (x + 1) / CHUNK_SIZE - 1 : x / CHUNK_SIZE;
+
+}
+
+static WorldPending *lookup(WorldPending *table, unsigned int mask, int p, int q)
+{
+
+    unsigned int index = ((unsigned int)p * 73856093u ^ (unsigned int)q * 19349663u) & mask;
+
+    while (table[index].capacity)
+    {
+
+        if (table[index].p == p && table[index].q == q)
+            return table + index;
+
+        index = (index + 1) & mask;
+
+    }
+
+    return table + index;
+
+}
+
+static void grow(void)
+{
+
+    WorldPending *table = pending;
+    unsigned int mask = pending_mask;
+    unsigned int i;
+
+    pending_mask = mask ? (mask << 1) | 1 : WORLD_PENDING_MIN - 1;
+    pending = (WorldPending *)calloc(pending_mask + 1, sizeof(WorldPending));
+
+    if (!table)
+        return;
+
+    for (i = 0; i <= mask; i++)
+    {
+
+        if (table[i].capacity)
+            *lookup(pending, pending_mask, table[i].p, table[i].q) = table[i];
+
+    }
+
+    free(table);
+
+}
+
+static void defer(int x, int y, int z, int w)
+{
+
+    int p = chunked(x);
+    int q = chunked(z);
+    WorldPending *list;
+    MapEntry edit;
+    unsigned int i;
+
+    if (y < 0 || y >= Y_SIZE)
+        return;
+
+    edit.e.x = x - p * CHUNK_SIZE;
+    edit.e.y = y;
+    edit.e.z = z - q * CHUNK_SIZE;
+    edit.e.w = w;
+
+    pthread_mutex_lock(&pending_mutex);
+
+    if ((pending_size + 1) * 2 > pending_mask)
+        grow();
+
+    list = lookup(pending, pending_mask, p, q);
+
+    if (!list->capacity)
+    {
+
+        list->p = p;
+        list->q = q;
+        list->capacity = 16;
+        list->edits = (MapEntry *)malloc(list->capacity * sizeof(MapEntry));
+        pending_size++;
+
+    }
+
+    for (i = 0; i < list->count; i++)
+    {
+
+        if (list->edits[i].e.x == edit.e.x && list->edits[i].e.y == edit.e.y && list->edits[i].e.z == edit.e.z)
+            break;
+
+    }
+
+    if (i == list->count)
+    {
+
+        if (list->count == list->capacity)
+        {
+
+            list->capacity *= 2;
+            list->edits = (MapEntry *)realloc(list->edits, list->capacity * sizeof(MapEntry));
+
+        }
+
+        list->edits[list->count++] = edit;
+        __atomic_fetch_add(&stats.edits, 1, __ATOMIC_RELAXED);
+
+    }
+
+    pthread_mutex_unlock(&pending_mutex);
+
+}
+
+static void place(WorldChunk *chunk, int x, int y, int z, int w)
+{
+
+    int i;
+
+    if (chunked(x) != chunk->p || chunked(z) != chunk->q)
+    {
+
+        defer(x, y, z, w);
+
+        return;
+
+    }
+
+    if (y < 0 || y >= Y_SIZE)
+        return;
+
+    i = (z - chunk->q * CHUNK_SIZE) * CHUNK_SIZE + (x - chunk->p * CHUNK_SIZE);
+
+    map_builder_set(&chunk->builder, x, y, z, w);
+
+    if (y > chunk->heights[i])
+        chunk->heights[i] = y;
+
+}
+
+static int terrain(WorldChunk *chunk)
+{
+
+    float mountains[CHUNK_SIZE * CHUNK_SIZE];
+    float peaks[CHUNK_SIZE * CHUNK_SIZE];
+    int dx, dz;
+
+    noise_simplex2_grid(chunk->noise, mountains, chunk->p * CHUNK_SIZE, chunk->q * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, 0.01, 0.01, 4, 0.5, 2);
+    noise_simplex2_grid(chunk->noise, peaks, chunk->p * CHUNK_SIZE, chunk->q * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, -0.01, -0.01, 2, 0.9, 2);
+
+    for (dz = 0; dz < CHUNK_SIZE; dz++)
+    {
+
+        for (dx = 0; dx < CHUNK_SIZE; dx++)
+        {
+
+            int x = chunk->p * CHUNK_SIZE + dx;
+            int z = chunk->q * CHUNK_SIZE + dz;
+            int i = dz * CHUNK_SIZE + dx;
+            int mh = peaks[i] * 32 + 16;
+            int h = mountains[i] * mh;
+
+            if (h <= 12)
+                h = 12;
+
+            map_builder_fill(&chunk->builder, x, 0, 10, z, CEMENT);
+            map_builder_fill(&chunk->builder, x, 10, 12, z, SAND);
+            map_builder_fill(&chunk->builder, x, 12, h - 1, z, DIRT);
+
+            chunk->ground[i] = h;
+            chunk->heights[i] = 11;
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+static int surface(WorldChunk *chunk)
+{
+
+    int dx, dz;
+
+    chunk->grass = 0;
+
+    for (dz = 0; dz < CHUNK_SIZE; dz++)
+    {
+
+        for (dx = 0; dx < CHUNK_SIZE; dx++)
+        {
+
+            int i = dz * CHUNK_SIZE + dx;
+            int h = chunk->ground[i];
+
+            if (h <= 12)
+                continue;
+
+            map_builder_set(&chunk->builder, chunk->p * CHUNK_SIZE + dx, h - 1, chunk->q * CHUNK_SIZE + dz, GRASS);
+
+            chunk->heights[i] = h - 1;
+            chunk->grass++;
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+static int decoration(WorldChunk *chunk)
+{
+
+    float grass[CHUNK_SIZE * CHUNK_SIZE];
+    float flowers[CHUNK_SIZE * CHUNK_SIZE];
+    float petals[CHUNK_SIZE * CHUNK_SIZE];
+    int dx, dz;
+
+    if (!chunk->grass)
+        return 0;
+
+    noise_simplex2_grid(chunk->noise, grass, chunk->p * CHUNK_SIZE, chunk->q * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, -0.1, 0.1, 4, 0.8, 2);
+    noise_simplex2_grid(chunk->noise, flowers, chunk->p * CHUNK_SIZE, chunk->q * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, 0.05, -0.05, 4, 0.8, 2);
+    noise_simplex2_grid(chunk->noise, petals, chunk->p * CHUNK_SIZE, chunk->q * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, 0.1, 0.1, 4, 0.8, 2);
+
+    for (dz = 0; dz < CHUNK_SIZE; dz++)
+    {
+
+        for (dx = 0; dx < CHUNK_SIZE; dx++)
+        {
+
+            int x = chunk->p * CHUNK_SIZE + dx;
+            int z = chunk->q * CHUNK_SIZE + dz;
+            int i = dz * CHUNK_SIZE + dx;
+            int h = chunk->ground[i];
+
+            if (h <= 12)
+                continue;
+
+            if (grass[i] > 0.6)
+            {
+
+                map_builder_set(&chunk->builder, x, h, z, TALL_GRASS);
+
+                chunk->heights[i] = h;
+
+            }
+
+            if (flowers[i] > 0.7)
+            {
+
+                map_builder_set(&chunk->builder, x, h, z, YELLOW_FLOWER + petals[i] * 7);
+
+                chunk->heights[i] = h;
+
+            }
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+static void sample_clouds(float *clouds, NoiseContext *noise, int p, int q)
+{
+
+    int lx = CHUNK_SIZE / CLOUD_STEP + 1;
+    int ly = 8 / CLOUD_STEP + 1;
+    float lattice[(CHUNK_SIZE / CLOUD_STEP + 1) * (8 / CLOUD_STEP + 1) * (CHUNK_SIZE / CLOUD_STEP + 1)];
+    int dx, dy, dz;
+
+    noise_simplex3_grid(noise, lattice, p * CHUNK_SIZE / CLOUD_STEP, 64 / CLOUD_STEP, q * CHUNK_SIZE / CLOUD_STEP, lx, ly, lx, 0.01 * CLOUD_STEP, 0.1 * CLOUD_STEP, 0.01 * CLOUD_STEP, 8, 0.5, 2);
+
+    for (dy = 0; dy < 8; dy++)
+    {
+
+        int y0 = dy / CLOUD_STEP;
+        float ty = (float)(dy % CLOUD_STEP) / CLOUD_STEP;
+
+        for (dz = 0; dz < CHUNK_SIZE; dz++)
+        {
+
+            int z0 = dz / CLOUD_STEP;
+            float tz = (float)(dz % CLOUD_STEP) / CLOUD_STEP;
+
+            for (dx = 0; dx < CHUNK_SIZE; dx++)
+            {
+
+                int x0 = dx / CLOUD_STEP;
+                float tx = (float)(dx % CLOUD_STEP) / CLOUD_STEP;
+                float *c = lattice + (y0 * lx + z0) * lx + x0;
+                float c00 = c[0] + (c[1] - c[0]) * tx;
+                float c01 = c[lx] + (c[lx + 1] - c[lx]) * tx;
+                float c10 = c[lx * lx] + (c[lx * lx + 1] - c[lx * lx]) * tx;
+                float c11 = c[lx * lx + lx] + (c[lx * lx + lx + 1] - c[lx * lx + lx]) * tx;
+                float c0 = c00 + (c01 - c00) * tz;
+                float c1 = c10 + (c11 - c10) * tz;
+
+                clouds[(dy * CHUNK_SIZE + dz) * CHUNK_SIZE + dx] = c0 + (c1 - c0) * ty;
+
+            }
+
+        }
+
+    }
+
+}
+
+static int clouds(WorldChunk *chunk)
+{
+
+    float clouds[8 * CHUNK_SIZE * CHUNK_SIZE];
+    float threshold = CLOUD_STEP > 1 ? 0.715 : 0.75;
+    int dx, dy, dz;
+
+    if (CLOUD_STEP > 1)
+        sample_clouds(clouds, chunk->noise, chunk->p, chunk->q);
+    else
+        noise_simplex3_grid(chunk->noise, clouds, chunk->p * CHUNK_SIZE, 64, chunk->q * CHUNK_SIZE, CHUNK_SIZE, 8, CHUNK_SIZE, 0.01, 0.1, 0.01, 8, 0.5, 2);
+
+    for (dy = 0; dy < 8; dy++)
+    {
+
+        for (dz = 0; dz < CHUNK_SIZE; dz++)
+        {
+
+            for (dx = 0; dx < CHUNK_SIZE; dx++)
+            {
+
+                int i = dz * CHUNK_SIZE + dx;
+
+                if (clouds[dy * CHUNK_SIZE * CHUNK_SIZE + i] <= threshold)
+                    continue;
+
+                map_builder_set(&chunk->builder, chunk->p * CHUNK_SIZE + dx, 64 + dy, chunk->q * CHUNK_SIZE + dz, CLOUD);
+
+                chunk->heights[i] = 64 + dy;
+
+            }
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+static int trees(WorldChunk *chunk)
+{
+
+    unsigned int seed;
+    int dx, dz;
+
+    if (!chunk->grass)
+        return 0;
+
+    seed = noise_chunk_seed(chunk->noise, chunk->p, chunk->q);
+
+    for (dz = 0; dz < CHUNK_SIZE; dz++)
+    {
+
+        for (dx = 0; dx < CHUNK_SIZE; dx++)
+        {
+
+            int x = chunk->p * CHUNK_SIZE + dx;
+            int z = chunk->q * CHUNK_SIZE + dz;
+            int h = chunk->ground[dz * CHUNK_SIZE + dx];
+            int ox, oz, y;
+
+            if (h <= 12)
+                continue;
+
+            seed = seed * 1664525u + 1013904223u;
+
+            if ((seed >> 24) >= WORLD_TREE_CHANCE)
+                continue;
+
+            for (y = h + 3; y < h + 8; y++)
+            {
+
+                for (ox = -3; ox <= 3; ox++)
+                {
+
+                    for (oz = -3; oz <= 3; oz++)
+                    {
+
+                        int d = ox * ox + oz * oz + (y - (h + 4)) * (y - (h + 4));
+
+                        if (d < 11)
+                            place(chunk, x + ox, y, z + oz, LEAVES);
+
+                    }
+
+                }
+
+            }
+
+            for (y = h; y < h + 7; y++)
+                place(chunk, x, y, z, WOOD);
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+static int edits(WorldChunk *chunk)
+{
+
+    WorldPending *list;
+    unsigned int i;
+
+    pthread_mutex_lock(&pending_mutex);
+
+    list = pending ? lookup(pending, pending_mask, chunk->p, chunk->q) : 0;
+
+    if (!list || !list->capacity)
+    {
+
+        pthread_mutex_unlock(&pending_mutex);
+
+        return 0;
+
+    }
+
+    for (i = 0; i < list->count; i++)
+    {
+
+        MapEntry *edit = list->edits + i;
+
+        place(chunk, chunk->p * CHUNK_SIZE + edit->e.x, edit->e.y, chunk->q * CHUNK_SIZE + edit->e.z, edit->e.w);
+
+    }
+
+    chunk->version = list->count;
+
+    pthread_mutex_unlock(&pending_mutex);
+
+    return 1;
+
+}
+
+static int build(WorldChunk *chunk)
+{
+
+    map_build(chunk->map, &chunk->builder);
+
+    return 1;
+
+}
+
+static WorldStage stages[WORLD_STAGES] = {
+    {"terrain", terrain},
+    {"surface", surface},
+    {"decoration", decoration},
+    {"trees", trees},
+    {"clouds", clouds},
+    {"edits", edits},
+    {"build", build}
+};
+
+static unsigned long long now(void)
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+}
+
+void world_alloc(Map *map, int p, int q)
+{
+
+    if (CHUNK_PALETTE)
+        map_alloc_palette(map, p * CHUNK_SIZE, 0, q * CHUNK_SIZE);
+    else
+        map_alloc(map, p * CHUNK_SIZE, 0, q * CHUNK_SIZE, 0x7fff);
+
+}
+
+unsigned int world_generate(Map *map, short *heights, NoiseContext *noise, int p, int q)
+{
+
+    WorldChunk chunk;
+    int i;
+
+    chunk.map = map;
+    chunk.heights = heights;
+    chunk.noise = noise;
+    chunk.p = p;
+    chunk.q = q;
+    chunk.grass = 0;
+    chunk.version = 0;
+
+    map_builder_alloc(&chunk.builder, map->dx, map->dy, map->dz);
+
+    for (i = 0; i < WORLD_STAGES; i++)
+    {
+
+        unsigned long long start = now();
+
+        if (stages[i].run(&chunk))
+            __atomic_fetch_add(&stats.runs[i], 1, __ATOMIC_RELAXED);
+        else
+            __atomic_fetch_add(&stats.skips[i], 1, __ATOMIC_RELAXED);
+
+        __atomic_fetch_add(&stats.ns[i], now() - start, __ATOMIC_RELAXED);
+
+    }
+
+    map_builder_free(&chunk.builder);
+    __atomic_fetch_add(&stats.chunks, 1, __ATOMIC_RELAXED);
+
+    return chunk.version;
+
+}
+
+int world_apply(Map *map, short *heights, int p, int q, unsigned int *version)
+{
+
+    WorldPending *list;
+    int count = 0;
+    unsigned int i;
+
+    pthread_mutex_lock(&pending_mutex);
+
+    list = pending ? lookup(pending, pending_mask, p, q) : 0;
+
+    for (i = *version; list && i < list->count; i++)
+    {
+
+        MapEntry *edit = list->edits + i;
+        short *height = heights + edit->e.z * CHUNK_SIZE + edit->e.x;
+
+        if (!map_set(map, p * CHUNK_SIZE + edit->e.x, edit->e.y, q * CHUNK_SIZE + edit->e.z, edit->e.w))
+            continue;
+
+        if (edit->e.y > *height)
+            *height = edit->e.y;
+
+        count++;
+
+    }
+
+    if (list && list->capacity)
+        *version = list->count;
+
+    pthread_mutex_unlock(&pending_mutex);
+
+    return count;
+
+}
+
+unsigned int world_version(int p, int q)
+{
+
+    WorldPending *list;
+    unsigned int version;
+
+    pthread_mutex_lock(&pending_mutex);
+
+    list = pending ? lookup(pending, pending_mask, p, q) : 0;
+    version = list ? list->count : 0;
+
+    pthread_mutex_unlock(&pending_mutex);
+
+    return version;
+
+}
+
+void world_clear(void)
+{
+
+    unsigned int i;
+
+    pthread_mutex_lock(&pending_mutex);
+
+    for (i = 0; pending && i <= pending_mask; i++)
+        free(pending[i].edits);
+
+    free(pending);
+
+    pending = 0;
+    pending_mask = 0;
+    pending_size = 0;
+    __atomic_store_n(&stats.edits, 0, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&pending_mutex);
+
+}
+
+const char *world_stage_name(int stage)
+{
+
+    return stages[stage].name;
+
+}
+
+void world_stats(WorldStats *out)
+{
+
+    int i;
+
+    out->chunks = __atomic_load_n(&stats.chunks, __ATOMIC_RELAXED);
+    out->edits = __atomic_load_n(&stats.edits, __ATOMIC_RELAXED);
+
+    for (i = 0; i < WORLD_STAGES; i++)
+    {
+
+        out->runs[i] = __atomic_load_n(&stats.runs[i], __ATOMIC_RELAXED);
+        out->skips[i] = __atomic_load_n(&stats.skips[i], __ATOMIC_RELAXED);
+        out->ns[i] = __atomic_load_n(&stats.ns[i], __ATOMIC_RELAXED);
+
+    }
+
+}
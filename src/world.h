@@ -0,0 +1,17 @@
+#define WORLD_STAGES                    7
+
+typedef struct {
+    unsigned int chunks;
+    unsigned int edits;
+    unsigned int runs[WORLD_STAGES];
+    unsigned int skips[WORLD_STAGES];
+    unsigned long long ns[WORLD_STAGES];
+} WorldStats;
+
+void world_alloc(Map *map, int p, int q);
+unsigned int world_generate(Map *map, short *heights, NoiseContext *noise, int p, int q);
+int world_apply(Map *map, short *heights, int p, int q, unsigned int *version);
+unsigned int world_version(int p, int q);
+void world_clear(void);
+const char *world_stage_name(int stage);
+void world_stats(WorldStats *stats);
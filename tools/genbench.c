@@ -0,0 +1,280 @@
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "palette.h"
+#include "map.h"
+#include "noise.h"
+#include "world.h"
+
+#define GENBENCH_SEED                   1234
+#define GENBENCH_EDITS                  4096
+
+typedef struct
+{
+
+    int p;
+    int q;
+    unsigned int hash;
+
+} Golden;
+
+typedef struct
+{
+
+    Map *map;
+    int p;
+    int q;
+    int stop;
+    unsigned int expected;
+    unsigned int reads;
+    unsigned int mismatches;
+    int *blocks;
+
+} Reader;
+
+static Golden goldens[] = {
+    {0, 0, 0x4d6e81b4},
+    {1, 0, 0x5b4a9536},
+    {0, 1, 0x805cf660},
+    {-1, -1, 0x76bac8ba},
+    {2, -3, 0xfa25f3cf},
+    {-5, 4, 0x7f0c0137},
+    {7, 7, 0x416f8cec},
+    {-12, 9, 0x2e9f0db0},
+    {31, -17, 0x5934233a},
+    {-40, -40, 0x692252a1},
+    {64, 3, 0xe1ef75a0},
+    {-100, 100, 0x586165be},
+    {250, -250, 0xf629fe56},
+    {-1000, 17, 0x22f28903},
+    {4096, 4096, 0x5bcf944d},
+    {-30000, -30000, 0x4c70d53c}
+};
+
+static int blocks[CHUNK_SIZE * CHUNK_SIZE * Y_SIZE];
+
+static double now(void)
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+static unsigned int hash(Map *map, int p, int q, int *blocks)
+{
+
+    unsigned int h = 2166136261u;
+    int i;
+
+    map_get_box(map, p * CHUNK_SIZE, 0, q * CHUNK_SIZE, CHUNK_SIZE, Y_SIZE, CHUNK_SIZE, blocks, CHUNK_SIZE, CHUNK_SIZE * CHUNK_SIZE);
+
+    for (i = 0; i < CHUNK_SIZE * CHUNK_SIZE * Y_SIZE; i++)
+    {
+
+        h ^= blocks[i] & 0xff;
+        h *= 16777619u;
+
+    }
+
+    return h;
+
+}
+
+static unsigned int generate(NoiseContext *noise, int p, int q)
+{
+
+    short heights[CHUNK_SIZE * CHUNK_SIZE];
+    unsigned int h;
+    Map map;
+
+    world_alloc(&map, p, q);
+    world_generate(&map, heights, noise, p, q);
+
+    h = hash(&map, p, q, blocks);
+
+    map_free(&map);
+
+    return h;
+
+}
+
+static void *read_snapshot(void *arg)
+{
+
+    Reader *reader = (Reader *)arg;
+
+    do
+    {
+
+        if (hash(reader->map, reader->p, reader->q, reader->blocks) != reader->expected)
+            reader->mismatches++;
+
+        reader->reads++;
+
+    } while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE));
+
+    return 0;
+
+}
+
+static int check_snapshot(NoiseContext *noise, Golden *golden, unsigned int *reads)
+{
+
+    short heights[CHUNK_SIZE * CHUNK_SIZE];
+    Map map;
+    Map snapshot;
+    Reader reader;
+    pthread_t thread;
+    int i;
+
+    world_alloc(&map, golden->p, golden->q);
+    world_generate(&map, heights, noise, golden->p, golden->q);
+    map_snapshot(&snapshot, &map);
+
+    reader.map = &snapshot;
+    reader.p = golden->p;
+    reader.q = golden->q;
+    reader.stop = 0;
+    reader.expected = golden->hash;
+    reader.reads = 0;
+    reader.mismatches = 0;
+    reader.blocks = (int *)malloc(sizeof(int) * CHUNK_SIZE * CHUNK_SIZE * Y_SIZE);
+
+    pthread_create(&thread, 0, read_snapshot, &reader);
+
+    srand(golden->p * 31 + golden->q);
+
+    for (i = 0; i < GENBENCH_EDITS; i++)
+        map_set(&map, golden->p * CHUNK_SIZE + rand() % CHUNK_SIZE, rand() % Y_SIZE, golden->q * CHUNK_SIZE + rand() % CHUNK_SIZE, rand() % 64);
+
+    map_compact(&map);
+
+    __atomic_store_n(&reader.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, 0);
+
+    if (hash(&snapshot, golden->p, golden->q, blocks) != golden->hash || hash(&map, golden->p, golden->q, blocks) == golden->hash)
+        reader.mismatches++;
+
+    map_free(&map);
+
+    if (hash(&snapshot, golden->p, golden->q, blocks) != golden->hash)
+        reader.mismatches++;
+
+    map_free(&snapshot);
+    free(reader.blocks);
+
+    *reads += reader.reads;
+
+    if (reader.mismatches)
+        printf("chunk (%d, %d): snapshot changed by %u edits\n", golden->p, golden->q, GENBENCH_EDITS);
+
+    return reader.mismatches == 0;
+
+}
+
+int main(int argc, char **argv)
+{
+
+    NoiseContext noise;
+    unsigned int count = sizeof(goldens) / sizeof(Golden);
+    unsigned int chunks = 0;
+    unsigned int failures = 0;
+    unsigned int snapshots = 0;
+    unsigned int reads = 0;
+    int iterations = 8;
+    int update = 0;
+    double elapsed = 0;
+    WorldStats world;
+    int i, j;
+
+    for (i = 1; i < argc; i++)
+    {
+
+        if (!strcmp(argv[i], "-u"))
+            update = 1;
+        else
+            iterations = MAX(1, atoi(argv[i]));
+
+    }
+
+    noise_seed(&noise, GENBENCH_SEED);
+
+    for (i = 0; i < count; i++)
+        generate(&noise, goldens[i].p, goldens[i].q);
+
+    for (i = 0; i < count; i++)
+    {
+
+        Golden *golden = goldens + i;
+        unsigned int h = generate(&noise, golden->p, golden->q);
+
+        if (update)
+        {
+
+            printf("    {%d, %d, 0x%08x}%s\n", golden->p, golden->q, h, i + 1 < count ? "," : "");
+
+        }
+
+        else if (h != golden->hash)
+        {
+
+            printf("chunk (%d, %d): hash %08x, expected %08x\n", golden->p, golden->q, h, golden->hash);
+
+            failures++;
+
+        }
+
+    }
+
+    if (update)
+        return 0;
+
+    for (i = 0; i < count; i++)
+        snapshots += check_snapshot(&noise, goldens + i, &reads);
+
+    for (j = 0; j < iterations; j++)
+    {
+
+        for (i = 0; i < count; i++)
+        {
+
+            Golden *golden = goldens + i;
+            short heights[CHUNK_SIZE * CHUNK_SIZE];
+            double start;
+            Map map;
+
+            world_alloc(&map, golden->p, golden->q);
+
+            start = now();
+
+            world_generate(&map, heights, &noise, golden->p, golden->q);
+
+            elapsed += now() - start;
+            chunks++;
+
+            map_free(&map);
+
+        }
+
+    }
+
+    world_stats(&world);
+
+    for (i = 0; i < WORLD_STAGES; i++)
+        printf("stage %s: %.3f ms/chunk %u skipped\n", world_stage_name(i), world.chunks ? world.ns[i] / 1e6 / world.chunks : 0, world.skips[i]);
+
+    printf("%u chunks in %.3f s: %.1f chunks/sec %.0f ns/column\n", chunks, elapsed, chunks / elapsed, elapsed * 1e9 / chunks / (CHUNK_SIZE * CHUNK_SIZE));
+    printf("%u of %u chunks match golden hashes\n", count - failures, count);
+    printf("%u of %u snapshots unchanged by edits (%u concurrent reads)\n", snapshots, count, reads);
+
+    return failures || snapshots != count ? 1 : 0;
+
+}
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "palette.h"
+#include "map.h"
+#include "cold.h"
+#include "bake.h"
+#include "noise.h"
+#include "world.h"
+
+#define PREGEN_SEED                     1234
+
+typedef struct
+{
+
+    pthread_t thread;
+    unsigned int chunks;
+    unsigned int patched;
+    unsigned int bytes;
+    unsigned int failures;
+    double generate;
+    double patch;
+    double write;
+
+} Worker;
+
+static NoiseContext noise;
+static int region_p;
+static int region_q;
+static int region_width;
+static int region_height;
+static unsigned int *versions;
+static unsigned int *remaining;
+static unsigned char **buffers;
+static unsigned int *sizes;
+static unsigned int region_size;
+static unsigned int next;
+
+static double now(clockid_t clock)
+{
+
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+static void finish(Worker *worker, unsigned int index, unsigned char *buffer)
+{
+
+    int p = region_p + index % region_width;
+    int q = region_q + index / region_width;
+    double start = now(CLOCK_THREAD_CPUTIME_ID);
+
+    if (world_version(p, q) != versions[index])
+    {
+
+        short heights[CHUNK_SIZE * CHUNK_SIZE];
+        Map map;
+
+        world_alloc(&map, p, q);
+        cold_decode(&map, heights, p, q, buffers[index]);
+        world_apply(&map, heights, p, q, versions + index);
+
+        free(buffers[index]);
+
+        sizes[index] = cold_encode(&map, p, q, buffer);
+        buffers[index] = (unsigned char *)malloc(sizes[index]);
+        memcpy(buffers[index], buffer, sizes[index]);
+
+        map_free(&map);
+
+        worker->patched++;
+        worker->patch += now(CLOCK_THREAD_CPUTIME_ID) - start;
+        start = now(CLOCK_THREAD_CPUTIME_ID);
+
+    }
+
+    if (!bake_write(p, q, buffers[index], sizes[index]))
+        worker->failures++;
+
+    worker->bytes += sizes[index];
+    worker->write += now(CLOCK_THREAD_CPUTIME_ID) - start;
+
+    free(buffers[index]);
+    buffers[index] = 0;
+
+}
+
+static void *worker_run(void *arg)
+{
+
+    Worker *worker = (Worker *)arg;
+    unsigned char *buffer = (unsigned char *)malloc(COLD_MAX_SIZE);
+    unsigned int index;
+
+    while ((index = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED)) < region_size)
+    {
+
+        int x = index % region_width;
+        int z = index / region_width;
+        double start = now(CLOCK_THREAD_CPUTIME_ID);
+        short heights[CHUNK_SIZE * CHUNK_SIZE];
+        Map map;
+        int dx, dz;
+
+        world_alloc(&map, region_p + x, region_q + z);
+        versions[index] = world_generate(&map, heights, &noise, region_p + x, region_q + z);
+
+        sizes[index] = cold_encode(&map, region_p + x, region_q + z, buffer);
+        buffers[index] = (unsigned char *)malloc(sizes[index]);
+        memcpy(buffers[index], buffer, sizes[index]);
+
+        map_free(&map);
+
+        worker->chunks++;
+        worker->generate += now(CLOCK_THREAD_CPUTIME_ID) - start;
+
+        for (dz = MAX(z - 1, 0); dz <= MIN(z + 1, region_height - 1); dz++)
+        {
+
+            for (dx = MAX(x - 1, 0); dx <= MIN(x + 1, region_width - 1); dx++)
+            {
+
+                unsigned int other = dz * region_width + dx;
+
+                if (!__atomic_sub_fetch(&remaining[other], 1, __ATOMIC_ACQ_REL))
+                    finish(worker, other, buffer);
+
+            }
+
+        }
+
+    }
+
+    free(buffer);
+
+    return 0;
+
+}
+
+static void usage(const char *name)
+{
+
+    fprintf(stderr, "usage: %s p q width height [file] [threads]\n", name);
+
+}
+
+int main(int argc, char **argv)
+{
+
+    Worker workers[MAX_WORKERS];
+    const char *path = BAKE_FILE;
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int chunks = 0;
+    unsigned int patched = 0;
+    unsigned int bytes = 0;
+    unsigned int failures = 0;
+    double generate = 0;
+    double patch = 0;
+    double write = 0;
+    double busy;
+    double start;
+    double elapsed;
+    double rate;
+    double single;
+    WorldStats world;
+    unsigned int index;
+    int i;
+
+    if (argc < 5)
+    {
+
+        usage(argv[0]);
+
+        return 1;
+
+    }
+
+    region_p = atoi(argv[1]);
+    region_q = atoi(argv[2]);
+    region_width = atoi(argv[3]);
+    region_height = atoi(argv[4]);
+
+    if (argc > 5)
+        path = argv[5];
+
+    if (argc > 6)
+        count = atoi(argv[6]);
+
+    if (region_width <= 0 || region_height <= 0)
+    {
+
+        usage(argv[0]);
+
+        return 1;
+
+    }
+
+    count = MAX(1, MIN(count, MAX_WORKERS));
+
+    noise_seed(&noise, PREGEN_SEED);
+
+    if (!bake_create(path, PREGEN_SEED, region_p, region_q, region_width, region_height))
+    {
+
+        fprintf(stderr, "%s: cannot create %s\n", argv[0], path);
+
+        return 1;
+
+    }
+
+    region_size = region_width * region_height;
+    versions = (unsigned int *)malloc(region_size * sizeof(unsigned int));
+    remaining = (unsigned int *)malloc(region_size * sizeof(unsigned int));
+    buffers = (unsigned char **)calloc(region_size, sizeof(unsigned char *));
+    sizes = (unsigned int *)malloc(region_size * sizeof(unsigned int));
+
+    for (index = 0; index < region_size; index++)
+    {
+
+        int x = index % region_width;
+        int z = index / region_width;
+
+        remaining[index] = (MIN(x + 1, region_width - 1) - MAX(x - 1, 0) + 1) * (MIN(z + 1, region_height - 1) - MAX(z - 1, 0) + 1);
+
+    }
+
+    for (i = 0; i < count; i++)
+        memset(workers + i, 0, sizeof(Worker));
+
+    start = now(CLOCK_MONOTONIC);
+
+    for (i = 0; i < count; i++)
+        pthread_create(&workers[i].thread, 0, worker_run, workers + i);
+
+    for (i = 0; i < count; i++)
+        pthread_join(workers[i].thread, 0);
+
+    if (!bake_finish())
+        failures++;
+
+    elapsed = now(CLOCK_MONOTONIC) - start;
+
+    for (i = 0; i < count; i++)
+    {
+
+        chunks += workers[i].chunks;
+        patched += workers[i].patched;
+        bytes += workers[i].bytes;
+        failures += workers[i].failures;
+        generate += workers[i].generate;
+        patch += workers[i].patch;
+        write += workers[i].write;
+
+    }
+
+    busy = generate + patch + write;
+    rate = chunks / elapsed;
+    single = busy > 0 ? chunks / busy : 0;
+
+    for (i = 0; i < count; i++)
+        printf("worker %d: %u chunks %.1f chunks/sec generated\n", i, workers[i].chunks, workers[i].generate > 0 ? workers[i].chunks / workers[i].generate : 0);
+
+    world_stats(&world);
+
+    for (i = 0; i < WORLD_STAGES; i++)
+        printf("stage %s: %.3f ms/chunk %u skipped\n", world_stage_name(i), world.chunks ? world.ns[i] / 1e6 / world.chunks : 0, world.skips[i]);
+
+    printf("generate %.2f s, patch %.2f s, write %.2f s of cpu time\n", generate, patch, write);
+    printf("%u chunks in %.2f s on %d threads: %.1f chunks/sec\n", chunks, elapsed, count, rate);
+    printf("scaling %.2fx over one core (%.0f%% efficiency)\n", single > 0 ? rate / single : 0, single > 0 ? rate / single / count * 100 : 0);
+    printf("patched %u of %u chunks with late cross-chunk edits\n", patched, chunks);
+    printf("wrote %s: %u kb\n", path, bytes / 1024);
+
+    free(versions);
+    free(remaining);
+    free(buffers);
+    free(sizes);
+    world_clear();
+
+    if (failures)
+    {
+
+        fprintf(stderr, "%s: %u chunks failed to write\n", argv[0], failures);
+
+        return 1;
+
+    }
+
+    return 0;
+
+}